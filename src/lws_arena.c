@@ -0,0 +1,250 @@
+/*
+ * LWS arena
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <lws_log.h>
+#include <lws_arena.h>
+
+
+#define LWS_ARENA_PAGE  4096  /* base block size granularity */
+#define LWS_ARENA_ROUND(n, m)  (((n) + ((m) - 1)) & ~(size_t)((m) - 1))
+
+
+static int lws_arena_add(lws_arena_t *a, size_t size);
+static void *lws_arena_alc_malloc(void *ctx, size_t size);
+static void *lws_arena_alc_realloc(void *ctx, void *ptr, size_t old_size, size_t size);
+static void lws_arena_alc_free(void *ctx, void *ptr);
+static size_t lws_region_round(size_t size);
+
+
+/*
+ * arena
+ */
+
+static int lws_arena_add (lws_arena_t *a, size_t size) {
+	lws_arena_block_t  *b;
+
+	if (size > SIZE_MAX - sizeof(lws_arena_block_t)) {
+		return -1;
+	}
+	b = lws_alloc(sizeof(lws_arena_block_t) + size);
+	if (!b) {
+		return -1;
+	}
+	b->next = a->block;
+	b->size = size;
+	a->block = b;
+	a->pos = (char *)(b + 1);
+	a->end = a->pos + size;
+	return 0;
+}
+
+lws_arena_t *lws_arena_create (size_t size) {
+	lws_arena_t  *a;
+
+	a = lws_calloc(sizeof(lws_arena_t));
+	if (!a) {
+		return NULL;
+	}
+	a->min = size;
+	a->size = size;
+	if (lws_arena_add(a, size) != 0) {
+		lws_free(a);
+		return NULL;
+	}
+	return a;
+}
+
+void lws_arena_free (lws_arena_t *a) {
+	lws_arena_block_t  *b, *next;
+
+	for (b = a->block; b; b = next) {
+		next = b->next;
+		lws_free(b);
+	}
+	lws_free(a);
+}
+
+void *lws_arena_alloc (lws_arena_t *a, size_t size) {
+	char  *p;
+
+	/* bump; an exhausted block is followed by one of at least the base size */
+	if (size > SIZE_MAX - (LWS_ARENA_ALIGN - 1)) {
+		return NULL;
+	}
+	size = LWS_ARENA_ROUND(size, LWS_ARENA_ALIGN);
+	if ((size_t)(a->end - a->pos) < size) {
+		if (lws_arena_add(a, size > a->size ? size : a->size) != 0) {
+			lws_log(LWS_LOG_CRIT, "out of memory");
+			return NULL;
+		}
+	}
+	p = a->pos;
+	a->pos += size;
+	a->used += size;
+	a->last = p;
+	return p;
+}
+
+void *lws_arena_realloc (lws_arena_t *a, void *p, size_t old_size, size_t size) {
+	char    *q;
+	size_t   old_len, len;
+
+	/* the last allocation grows or shrinks in place if the block permits */
+	if (!p) {
+		return lws_arena_alloc(a, size);
+	}
+	if (size > SIZE_MAX - (LWS_ARENA_ALIGN - 1)) {
+		return NULL;
+	}
+	old_len = LWS_ARENA_ROUND(old_size, LWS_ARENA_ALIGN);
+	len = LWS_ARENA_ROUND(size, LWS_ARENA_ALIGN);
+	if (p == a->last && (size_t)(a->end - (char *)p) >= len) {
+		a->pos = (char *)p + len;
+		a->used = a->used - old_len + len;
+		return p;
+	}
+
+	/* otherwise, copy; the old allocation is released on reset */
+	q = lws_arena_alloc(a, size);
+	if (!q) {
+		return NULL;
+	}
+	memcpy(q, p, old_size < size ? old_size : size);
+	return q;
+}
+
+void lws_arena_reset (lws_arena_t *a) {
+	size_t              size;
+	lws_arena_block_t  *b, *next;
+
+	/* decaying high-water mark, and the base block size it calls for */
+	a->high -= a->high / 8;
+	if (a->used > a->high) {
+		a->high = a->used;
+	}
+	a->used = 0;
+	a->last = NULL;
+	size = a->high <= SIZE_MAX - (LWS_ARENA_PAGE - 1) ? LWS_ARENA_ROUND(a->high, LWS_ARENA_PAGE)
+			: a->high;
+	if (size < a->min) {
+		size = a->min;
+	}
+
+	/* steady state: rewind the base block */
+	if (a->block && !a->block->next && a->block->size >= size && a->block->size / 2 <= size) {
+		a->pos = (char *)(a->block + 1);
+		return;
+	}
+
+	/* overflowed or oversized: replace the blocks with a single base block */
+	for (b = a->block; b; b = next) {
+		next = b->next;
+		lws_free(b);
+	}
+	a->block = NULL;
+	a->pos = NULL;
+	a->end = NULL;
+	a->size = size;
+	(void)lws_arena_add(a, size);  /* retried on the next allocation */
+}
+
+
+/*
+ * yyjson allocator
+ */
+
+static void *lws_arena_alc_malloc (void *ctx, size_t size) {
+	return lws_arena_alloc(ctx, size);
+}
+
+static void *lws_arena_alc_realloc (void *ctx, void *ptr, size_t old_size, size_t size) {
+	return lws_arena_realloc(ctx, ptr, old_size, size);
+}
+
+static void lws_arena_alc_free (void *ctx, void *ptr) {
+	/* released on reset */
+}
+
+void lws_arena_alc (lws_arena_t *a, yyjson_alc *alc) {
+	alc->malloc = lws_arena_alc_malloc;
+	alc->realloc = lws_arena_alc_realloc;
+	alc->free = lws_arena_alc_free;
+	alc->ctx = a;
+}
+
+
+/*
+ * region
+ */
+
+static size_t lws_region_round (size_t size) {
+	size_t  page;
+
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	return size <= SIZE_MAX - (page - 1) ? (size + (page - 1)) / page * page : size;
+}
+
+int lws_region_reserve (lws_region_t *r, size_t size) {
+	void  *data;
+
+	/* address space only; pages are committed as the region grows */
+	size = lws_region_round(size);
+	data = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (data == MAP_FAILED) {
+		lws_log(LWS_LOG_CRIT, "failed to reserve region size:%zu", size);
+		return -1;
+	}
+	r->data = data;
+	r->reserved = size;
+	r->committed = 0;
+	return 0;
+}
+
+int lws_region_commit (lws_region_t *r, size_t size) {
+	/* grow in place; committed data never moves */
+	if (size <= r->committed) {
+		return 0;
+	}
+	if (size > r->reserved) {
+		lws_log(LWS_LOG_ERR, "region exhausted size:%zu reserved:%zu", size, r->reserved);
+		return -1;
+	}
+	size = lws_region_round(size);
+	if (size > r->reserved) {
+		size = r->reserved;
+	}
+	if (mprotect(r->data + r->committed, size - r->committed, PROT_READ | PROT_WRITE) != 0) {
+		lws_log(LWS_LOG_CRIT, "failed to commit region size:%zu", size);
+		return -1;
+	}
+	r->committed = size;
+	return 0;
+}
+
+void lws_region_decommit (lws_region_t *r, size_t size) {
+	/* return the pages above size to the operating system */
+	size = lws_region_round(size);
+	if (size >= r->committed) {
+		return;
+	}
+	if (madvise(r->data + size, r->committed - size, MADV_DONTNEED) != 0
+			|| mprotect(r->data + size, r->committed - size, PROT_NONE) != 0) {
+		return;
+	}
+	r->committed = size;
+}
+
+void lws_region_free (lws_region_t *r) {
+	if (r->data) {
+		munmap(r->data, r->reserved);
+		r->data = NULL;
+	}
+	r->reserved = 0;
+	r->committed = 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * LWS arena
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#ifndef _LWS_ARENA_INCLUDED
+#define _LWS_ARENA_INCLUDED
+
+
+#include <yyjson.h>
+#include <lws_ngx.h>
+
+
+#define LWS_ARENA_ALIGN  16
+
+
+typedef struct lws_arena_s lws_arena_t;
+typedef struct lws_arena_block_s lws_arena_block_t;
+typedef struct lws_region_s lws_region_t;
+
+struct lws_arena_block_s {
+	lws_arena_block_t  *next;  /* next block; the base block is last */
+	size_t              size;  /* usable size */
+};
+
+struct lws_arena_s {
+	lws_arena_block_t  *block;  /* current block */
+	char               *pos;    /* allocation position */
+	char               *end;    /* end of the current block */
+	char               *last;   /* last allocation; may be resized in place */
+	size_t              min;    /* minimum base block size */
+	size_t              size;   /* base block size */
+	size_t              used;   /* bytes allocated since reset */
+	size_t              high;   /* decaying high-water mark of used bytes */
+};
+
+struct lws_region_s {
+	char    *data;       /* reserved address space; NULL = none */
+	size_t   reserved;   /* reserved size */
+	size_t   committed;  /* committed size from the start */
+};
+
+
+lws_arena_t *lws_arena_create(size_t size);
+void lws_arena_free(lws_arena_t *a);
+void *lws_arena_alloc(lws_arena_t *a, size_t size);
+void *lws_arena_realloc(lws_arena_t *a, void *p, size_t old_size, size_t size);
+void lws_arena_reset(lws_arena_t *a);
+void lws_arena_alc(lws_arena_t *a, yyjson_alc *alc);
+int lws_region_reserve(lws_region_t *r, size_t size);
+int lws_region_commit(lws_region_t *r, size_t size);
+void lws_region_decommit(lws_region_t *r, size_t size);
+void lws_region_free(lws_region_t *r);
+
+
+#endif /* _LWS_ARENA_INCLUDED */
@@ -0,0 +1,985 @@
+/*
+ * LWS native runtime API client
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <lws_runtime.h>
+#include <lws_log.h>
+#include <lws_client.h>
+#include <lws_interface.h>
+
+
+#define LWS_CLIENT_HEAD_SIZE   4096      /* initial next invocation header block capacity */
+#define LWS_CLIENT_HEAD_MAX    65536     /* maximum next invocation header block capacity */
+#define LWS_CLIENT_IN_SIZE     16384     /* input stream capacity */
+#define LWS_CLIENT_OUT_SIZE    65536     /* streaming chunk buffer capacity */
+#define LWS_CLIENT_CHUNK_HEAD  18        /* room for the chunk size line in front of chunk data */
+#define LWS_CLIENT_STALE       1         /* connection closed by peer before responding */
+#define LWS_CLIENT_CHUNKED     "Transfer-Encoding: chunked\r\n\r\n"
+
+
+typedef struct lws_client_resp_s {
+	int       status;          /* HTTP status code */
+	off_t     content_length;  /* content length; -1 if not present */
+	unsigned  chunked:1;       /* chunked transfer encoding */
+	unsigned  close:1;         /* connection is closed after the response */
+} lws_client_resp_t;
+
+
+static int lws_client_format(lws_str_t *dest, const char *fmt, ...)
+		__attribute__((format(printf, 2, 3)));
+static int lws_client_alloc_buf(lws_client_buf_t *b, size_t cap);
+static void lws_client_close(lws_client_t *c);
+static int lws_client_connect(lws_client_t *c);
+static int lws_client_closed(lws_client_t *c);
+static int lws_client_send(lws_client_t *c, struct iovec *iov, int iovcnt);
+static ssize_t lws_client_recv(lws_client_t *c, char *buf, size_t len);
+static int lws_client_read_head(lws_client_t *c, lws_client_buf_t *b, size_t max,
+		size_t *head_len);
+static int lws_client_read_line(lws_client_t *c, lws_client_buf_t *b, char **line, size_t *len);
+static int lws_client_parse_head(lws_ctx_t *ctx, char *data, size_t len, lws_client_resp_t *resp,
+		int store);
+static int lws_client_reserve(lws_ctx_t *ctx, size_t len);
+static int lws_client_sink(lws_ctx_t *ctx, char *data, size_t len);
+static int lws_client_read_chunked(lws_client_t *c, lws_client_buf_t *b, lws_ctx_t *ctx);
+static int lws_client_read_body(lws_client_t *c, lws_client_buf_t *b, lws_client_resp_t *resp,
+		lws_ctx_t *ctx);
+static int lws_client_read_response(lws_ctx_t *ctx, int next, lws_client_resp_t *resp);
+static int lws_client_request(lws_client_t *c, struct iovec *iov, int iovcnt, int *reused);
+static void lws_client_send_next(lws_ctx_t *ctx);
+static int lws_client_exchange(lws_ctx_t *ctx, struct iovec *iov, int iovcnt, int next, int sent);
+static void lws_client_select(lws_ctx_t *ctx, lws_client_target_e target);
+static int lws_client_target(lws_ctx_t *ctx, lws_client_target_e target, struct iovec *iov);
+
+
+lws_str_t lws_http_clients[] = {
+	lws_string("curl"),
+	lws_string("native"),
+	lws_null_string
+};
+
+
+/*
+ * helpers
+ */
+
+static int lws_client_format (lws_str_t *dest, const char *fmt, ...) {
+	int      n;
+	va_list  ap;
+
+	va_start(ap, fmt);
+	n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (n < 0) {
+		return -1;
+	}
+	dest->data = lws_alloc((size_t)n + 1);
+	if (!dest->data) {
+		return -1;
+	}
+	va_start(ap, fmt);
+	(void)vsnprintf(dest->data, (size_t)n + 1, fmt, ap);
+	va_end(ap);
+	dest->len = (size_t)n;
+	return 0;
+}
+
+static int lws_client_alloc_buf (lws_client_buf_t *b, size_t cap) {
+	b->data = lws_alloc(cap);
+	if (!b->data) {
+		return -1;
+	}
+	b->len = 0;
+	b->pos = 0;
+	b->cap = cap;
+	return 0;
+}
+
+
+/*
+ * connection
+ */
+
+static void lws_client_close (lws_client_t *c) {
+	if (c->conn->fd >= 0) {
+		close(c->conn->fd);
+		c->conn->fd = -1;
+	}
+	c->conn->requests = 0;
+	c->streaming = 0;
+	c->in.len = 0;
+	c->in.pos = 0;
+}
+
+static int lws_client_connect (lws_client_t *c) {
+	int  fd, one;
+
+	if (c->cancelled) {
+		return -1;
+	}
+	fd = socket(c->addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		lws_log(LWS_LOG_CRIT, "failed to create socket: %s", strerror(errno));
+		return -1;
+	}
+	one = 1;
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0) {
+		lws_log(LWS_LOG_WARN, "failed to set TCP_NODELAY: %s", strerror(errno));
+	}
+	if (connect(fd, (struct sockaddr *)&c->addr, c->addr_len) != 0) {
+		lws_log(LWS_LOG_CRIT, "failed to connect to runtime API: %s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+	if (lws_loop_add(c->loop, fd, EPOLLIN | EPOLLET) != 0) {
+		close(fd);
+		return -1;
+	}
+	c->conn->fd = fd;
+	c->conn->requests = 0;
+	lws_log_debug("connected socket fd:%d", fd);
+	return 0;
+}
+
+static int lws_client_closed (lws_client_t *c) {
+	char     ch;
+	ssize_t  n;
+
+	n = recv(c->conn->fd, &ch, 1, MSG_PEEK | MSG_DONTWAIT);
+	return !(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+static int lws_client_send (lws_client_t *c, struct iovec *iov, int iovcnt) {
+	ssize_t        n;
+	struct msghdr  msg;
+
+	lws_memzero(&msg, sizeof(msg));
+	while (iovcnt > 0) {
+		msg.msg_iov = iov;
+		msg.msg_iovlen = (size_t)iovcnt;
+		n = sendmsg(c->conn->fd, &msg, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= (size_t)n;
+		}
+	}
+	return 0;
+}
+
+static ssize_t lws_client_recv (lws_client_t *c, char *buf, size_t len) {
+	int      rc;
+	ssize_t  n;
+
+	/* receive, waiting on the event loop; only polling for the next invocation is cancellable */
+	while ((n = recv(c->conn->fd, buf, len, MSG_DONTWAIT)) < 0) {
+		if (errno == EINTR) {
+			continue;
+		}
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			return -1;
+		}
+		if ((rc = lws_loop_wait(c->loop, c->polling)) != 0) {
+			if (rc == LWS_LOOP_STOPPED) {
+				c->cancelled = 1;
+				errno = ECANCELED;
+			}
+			return -1;
+		}
+	}
+	return n;
+}
+
+
+/*
+ * response parsing
+ */
+
+static int lws_client_read_head (lws_client_t *c, lws_client_buf_t *b, size_t max,
+		size_t *head_len) {
+	char     *end, *data_new;
+	size_t    scan, cap;
+	ssize_t   n;
+
+	scan = b->pos;
+	while (1) {
+		end = memmem(b->data + scan, b->len - scan, "\r\n\r\n", 4);
+		if (end) {
+			*head_len = (size_t)(end + 4 - (b->data + b->pos));
+			return 0;
+		}
+		scan = b->len - b->pos > 3 ? b->len - 3 : b->pos;
+		if (b->len == b->cap) {
+			if (b->cap >= max) {
+				lws_log(LWS_LOG_ERR, "runtime API response header too large");
+				return -1;
+			}
+			cap = b->cap * 2 < max ? b->cap * 2 : max;
+			data_new = lws_realloc(b->data, cap);
+			if (!data_new) {
+				return -1;
+			}
+			b->data = data_new;
+			b->cap = cap;
+		}
+		n = lws_client_recv(c, b->data + b->len, b->cap - b->len);
+		if (n <= 0) {
+			if ((n == 0 || errno == ECONNRESET) && b->len == b->pos) {
+				return LWS_CLIENT_STALE;
+			}
+			return -1;
+		}
+		b->len += (size_t)n;
+	}
+}
+
+static int lws_client_read_line (lws_client_t *c, lws_client_buf_t *b, char **line, size_t *len) {
+	char     *eol;
+	ssize_t   n;
+
+	while (1) {
+		eol = memmem(b->data + b->pos, b->len - b->pos, "\r\n", 2);
+		if (eol) {
+			*line = b->data + b->pos;
+			*len = (size_t)(eol - *line);
+			b->pos = (size_t)(eol - b->data) + 2;
+			return 0;
+		}
+		if (b->pos > 0) {
+			memmove(b->data, b->data + b->pos, b->len - b->pos);
+			b->len -= b->pos;
+			b->pos = 0;
+		}
+		if (b->len == b->cap) {
+			lws_log(LWS_LOG_ERR, "runtime API response line too long");
+			return -1;
+		}
+		n = lws_client_recv(c, b->data + b->len, b->cap - b->len);
+		if (n <= 0) {
+			return -1;
+		}
+		b->len += (size_t)n;
+	}
+}
+
+static int lws_client_parse_head (lws_ctx_t *ctx, char *data, size_t len, lws_client_resp_t *resp,
+		int store) {
+	char          *line, *last, *eol, *colon, *val, *end;
+	size_t         name_len, val_len, count;
+	lws_str_t      key, *value;
+	unsigned long  ul;
+
+	/* status line */
+	last = data + len;
+	eol = memmem(data, len, "\r\n", 2);
+	if (!eol || eol - data < 12 || lws_strncmp(data, "HTTP/1.", 7) != 0 || data[8] != ' '
+			|| data[9] < '1' || data[9] > '5' || data[10] < '0' || data[10] > '9'
+			|| data[11] < '0' || data[11] > '9') {
+		lws_log(LWS_LOG_ERR, "bad runtime API status line");
+		return -1;
+	}
+	resp->status = (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+	resp->content_length = -1;
+	resp->chunked = 0;
+	resp->close = data[7] == '0';
+
+	/* headers */
+	count = 0;
+	for (line = eol + 2; line < last; line = eol + 2) {
+		eol = memmem(line, (size_t)(last - line), "\r\n", 2);
+		if (!eol || eol == line) {
+			break;
+		}
+		colon = memchr(line, ':', (size_t)(eol - line));
+		if (!colon || colon == line) {
+			continue;
+		}
+		name_len = (size_t)(colon - line);
+		val = colon + 1;
+		while (val < eol && (*val == ' ' || *val == '\t')) {
+			val++;
+		}
+		val_len = (size_t)(eol - val);
+		while (val_len && (val[val_len - 1] == ' ' || val[val_len - 1] == '\t')) {
+			val_len--;
+		}
+		lws_log_debug("header name:%.*s: val:%.*s", (int)name_len, line, (int)val_len, val);
+
+		/* framing */
+		if (name_len == 14 && lws_strncasecmp(line, "Content-Length", 14) == 0) {
+			errno = 0;
+			ul = strtoul(val, &end, 10);
+			if (errno != 0 || end != val + val_len || val_len == 0) {
+				lws_log(LWS_LOG_ERR, "bad runtime API content length");
+				return -1;
+			}
+			resp->content_length = (off_t)ul;
+		} else if (name_len == 17 && lws_strncasecmp(line, "Transfer-Encoding", 17) == 0) {
+			resp->chunked = val_len >= 7 && lws_strncasecmp(val + val_len - 7, "chunked", 7) == 0;
+		} else if (name_len == 10 && lws_strncasecmp(line, "Connection", 10) == 0) {
+			resp->close = val_len == 5 && lws_strncasecmp(val, "close", 5) == 0;
+		}
+
+		/* store in place */
+		if (!store) {
+			continue;
+		}
+		key.len = name_len;
+		key.data = line;
+		if (lws_table_get(ctx->headers, &key)) {
+			lws_log_debug("ignoring repeated header name:%.*s", (int)name_len, line);
+			continue;
+		}
+		if (count == LWS_CLIENT_HEADERS_MAX) {
+			lws_log(LWS_LOG_WARN, "too many runtime API headers");
+			continue;
+		}
+		val[val_len] = '\0';  /* overwrites whitespace or CR */
+		value = &ctx->client->values[count++];
+		value->len = val_len;
+		value->data = val;
+		if (lws_table_set(ctx->headers, &key, value) != 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * body
+ */
+
+static int lws_client_reserve (lws_ctx_t *ctx, size_t len) {
+	char    *body_new;
+	size_t   required, capacity;
+
+	if (len > SIZE_MAX - YYJSON_PADDING_SIZE - ctx->body.len) {
+		lws_log(LWS_LOG_ERR, "request body too large len:%zu body.len:%zu", len, ctx->body.len);
+		return -1;
+	}
+	required = ctx->body.len + len + YYJSON_PADDING_SIZE;
+	capacity = ctx->body_cap;
+	if (capacity >= required) {
+		return 0;
+	}
+	if (capacity == 0) {
+		capacity = 4096;
+	}
+	while (capacity < required) {
+		if (capacity <= SIZE_MAX / 2) {
+			capacity *= 2;
+		} else {
+			capacity = required;
+		}
+	}
+	body_new = lws_realloc(ctx->body.data, capacity);
+	if (!body_new) {
+		return -1;
+	}
+	ctx->body.data = body_new;
+	ctx->body_cap = capacity;
+	return 0;
+}
+
+static int lws_client_sink (lws_ctx_t *ctx, char *data, size_t len) {
+	if (!ctx || !len) {
+		return 0;
+	}
+	if (lws_client_reserve(ctx, len) != 0) {
+		return -1;
+	}
+	memcpy(ctx->body.data + ctx->body.len, data, len);
+	ctx->body.len += len;
+	return 0;
+}
+
+static int lws_client_read_chunked (lws_client_t *c, lws_client_buf_t *b, lws_ctx_t *ctx) {
+	char           *line, *end;
+	size_t          len, n;
+	ssize_t         rc;
+	unsigned long   size;
+
+	while (1) {
+		/* chunk size */
+		if (lws_client_read_line(c, b, &line, &len) != 0) {
+			return -1;
+		}
+		errno = 0;
+		size = strtoul(line, &end, 16);
+		if (errno != 0 || end == line || end > line + len) {
+			lws_log(LWS_LOG_ERR, "bad runtime API chunk size");
+			return -1;
+		}
+
+		/* last chunk and trailers */
+		if (size == 0) {
+			do {
+				if (lws_client_read_line(c, b, &line, &len) != 0) {
+					return -1;
+				}
+			} while (len);
+			return 0;
+		}
+
+		/* chunk data */
+		while (size) {
+			if (b->pos == b->len) {
+				b->pos = 0;
+				b->len = 0;
+				rc = lws_client_recv(c, b->data, b->cap);
+				if (rc <= 0) {
+					return -1;
+				}
+				b->len = (size_t)rc;
+			}
+			n = b->len - b->pos < size ? b->len - b->pos : size;
+			if (lws_client_sink(ctx, b->data + b->pos, n) != 0) {
+				return -1;
+			}
+			b->pos += n;
+			size -= n;
+		}
+		if (lws_client_read_line(c, b, &line, &len) != 0 || len != 0) {
+			return -1;
+		}
+	}
+}
+
+static int lws_client_read_body (lws_client_t *c, lws_client_buf_t *b, lws_client_resp_t *resp,
+		lws_ctx_t *ctx) {
+	char     *data_new;
+	size_t    remain, n, cap;
+	ssize_t   rc;
+
+	/* chunked */
+	if (resp->chunked) {
+		if (b != &c->in) {
+			/* move buffered body bytes to the input stream; the header block may have grown
+			 * beyond the input stream capacity */
+			n = b->len - b->pos;
+			if (n > c->in.cap) {
+				cap = c->in.cap;
+				while (cap < n) {
+					cap *= 2;
+				}
+				data_new = lws_realloc(c->in.data, cap);
+				if (!data_new) {
+					return -1;
+				}
+				c->in.data = data_new;
+				c->in.cap = cap;
+			}
+			memcpy(c->in.data, b->data + b->pos, n);
+			c->in.len = n;
+			c->in.pos = 0;
+			b->pos = b->len;
+		}
+		return lws_client_read_chunked(c, &c->in, ctx);
+	}
+
+	/* until close */
+	if (resp->content_length < 0) {
+		resp->close = 1;
+		if (lws_client_sink(ctx, b->data + b->pos, b->len - b->pos) != 0) {
+			return -1;
+		}
+		b->pos = b->len;
+		while (1) {
+			if (ctx) {
+				if (lws_client_reserve(ctx, 4096) != 0) {
+					return -1;
+				}
+				rc = lws_client_recv(c, ctx->body.data + ctx->body.len, 4096);
+			} else {
+				rc = lws_client_recv(c, c->in.data, c->in.cap);
+			}
+			if (rc < 0) {
+				return -1;
+			}
+			if (rc == 0) {
+				return 0;
+			}
+			if (ctx) {
+				ctx->body.len += (size_t)rc;
+			}
+		}
+	}
+
+	/* content length; buffered bytes first, then directly into the body */
+	remain = (size_t)resp->content_length;
+	n = b->len - b->pos < remain ? b->len - b->pos : remain;
+	if (ctx && lws_client_reserve(ctx, remain) != 0) {
+		return -1;
+	}
+	if (lws_client_sink(ctx, b->data + b->pos, n) != 0) {
+		return -1;
+	}
+	b->pos += n;
+	remain -= n;
+	while (remain) {
+		if (ctx) {
+			rc = lws_client_recv(c, ctx->body.data + ctx->body.len, remain);
+		} else {
+			rc = lws_client_recv(c, c->in.data, remain < c->in.cap ? remain : c->in.cap);
+		}
+		if (rc <= 0) {
+			return -1;
+		}
+		if (ctx) {
+			ctx->body.len += (size_t)rc;
+		}
+		remain -= (size_t)rc;
+	}
+	return 0;
+}
+
+static int lws_client_read_response (lws_ctx_t *ctx, int next, lws_client_resp_t *resp) {
+	int                rc;
+	size_t             head_len;
+	lws_client_t      *c;
+	lws_client_buf_t  *b;
+
+	/* header block; the next invocation header block is retained as header values refer to it */
+	c = ctx->client;
+	b = next ? &c->head : &c->in;
+	b->len = 0;
+	b->pos = 0;
+	rc = lws_client_read_head(c, b, next ? LWS_CLIENT_HEAD_MAX : b->cap, &head_len);
+	if (rc != 0) {
+		return rc;
+	}
+	if (lws_client_parse_head(ctx, b->data, head_len, resp, next) != 0) {
+		return -1;
+	}
+	b->pos = head_len;
+
+	/* body */
+	if (next && lws_client_reserve(ctx, 0) != 0) {
+		return -1;
+	}
+	if (lws_client_read_body(c, b, resp, next ? ctx : NULL) != 0) {
+		return -1;
+	}
+	c->in.len = 0;
+	c->in.pos = 0;
+	if (resp->close) {
+		lws_client_close(c);
+	}
+	return 0;
+}
+
+static int lws_client_request (lws_client_t *c, struct iovec *iov, int iovcnt, int *reused) {
+	struct iovec  iov_send[8];
+
+	/* connect as needed */
+	if (c->conn->fd < 0 && lws_client_connect(c) != 0) {
+		return -1;
+	}
+	*reused = c->conn->requests > 0;
+	c->conn->requests++;
+
+	/* send request */
+	memcpy(iov_send, iov, (size_t)iovcnt * sizeof(struct iovec));
+	if (lws_client_send(c, iov_send, iovcnt) != 0) {
+		return errno == EPIPE || errno == ECONNRESET ? LWS_CLIENT_STALE : -1;
+	}
+	return 0;
+}
+
+static void lws_client_send_next (lws_ctx_t *ctx) {
+	int                 reused;
+	lws_client_t       *c;
+	struct iovec        iov[1];
+	lws_client_conn_t  *conn;
+
+	/* send the next invocation request while the response is still being acknowledged */
+	c = ctx->client;
+	if (c->next_sent) {
+		return;
+	}
+	conn = c->conn;
+	c->conn = &c->next_conn;
+	iov[0].iov_base = c->next.data;
+	iov[0].iov_len = c->next.len;
+	if (lws_client_request(c, iov, 1, &reused) == 0) {
+		c->next_sent = 1;
+		c->next_reused = reused;
+	} else {
+		lws_log_debug("failed to send early next invocation request");
+		lws_client_close(c);
+	}
+	c->conn = conn;
+}
+
+static int lws_client_exchange (lws_ctx_t *ctx, struct iovec *iov, int iovcnt, int next, int sent) {
+	int                 rc, reused, attempt;
+	lws_client_t       *c;
+	lws_client_resp_t   resp;
+
+	c = ctx->client;
+	for (attempt = 0; ; attempt++) {
+		/* send request unless already sent, overlap next invocation request, read response */
+		if (sent) {
+			sent = 0;
+			reused = c->next_reused;
+			rc = 0;
+		} else {
+			rc = lws_client_request(c, iov, iovcnt, &reused);
+		}
+		if (rc == 0) {
+			if (!next && ctx->overlap && c->conn == &c->post_conn) {
+				lws_client_send_next(ctx);
+			}
+			rc = lws_client_read_response(ctx, next, &resp);
+		}
+		if (rc == 0) {
+			break;
+		}
+
+		/* retry once if a reused connection was closed by the peer */
+		lws_client_close(c);
+		if (rc == LWS_CLIENT_STALE && reused && attempt == 0 && !c->cancelled) {
+			lws_log_debug("retrying on stale connection");
+			continue;
+		}
+		if (c->cancelled) {
+			lws_log(LWS_LOG_NOTICE, "poll cancelled");
+		} else {
+			lws_log(LWS_LOG_CRIT, "runtime API request failed: %s",
+					rc == LWS_CLIENT_STALE ? "connection closed" : strerror(errno));
+		}
+		return -1;
+	}
+
+	/* check status */
+	if (resp.status < 200 || resp.status >= 300) {
+		lws_log(LWS_LOG_CRIT, "bad HTTP status code:%d", resp.status);
+		return -1;
+	}
+	return 0;
+}
+
+static void lws_client_select (lws_ctx_t *ctx, lws_client_target_e target) {
+	lws_client_t  *c;
+
+	/* with overlap, invocation responses use a second connection */
+	c = ctx->client;
+	c->conn = ctx->overlap && target != LWS_CLIENT_INIT_ERROR ? &c->post_conn : &c->next_conn;
+}
+
+static int lws_client_target (lws_ctx_t *ctx, lws_client_target_e target, struct iovec *iov) {
+	lws_client_t  *c;
+
+	c = ctx->client;
+	if (target == LWS_CLIENT_INIT_ERROR) {
+		iov[0].iov_base = c->init_error.data;
+		iov[0].iov_len = c->init_error.len;
+		return 1;
+	}
+	iov[0].iov_base = c->invocation.data;
+	iov[0].iov_len = c->invocation.len;
+	iov[1].iov_base = ctx->request_id->data;
+	iov[1].iov_len = ctx->request_id->len;
+	if (target == LWS_CLIENT_RESPONSE) {
+		iov[2].iov_base = c->response.data;
+		iov[2].iov_len = c->response.len;
+	} else {
+		iov[2].iov_base = c->error.data;
+		iov[2].iov_len = c->error.len;
+	}
+	return 3;
+}
+
+
+/*
+ * client
+ */
+
+lws_client_t *lws_client_create (lws_str_t *runtime_api, lws_loop_t *loop) {
+	int               rc;
+	char              host[256], *port, *p;
+	lws_client_t     *c;
+	struct addrinfo   hints, *res;
+
+	/* split host and port */
+	if (runtime_api->len >= sizeof(host)) {
+		lws_log(LWS_LOG_EMERG, "runtime API address too long");
+		return NULL;
+	}
+	memcpy(host, runtime_api->data, runtime_api->len);
+	host[runtime_api->len] = '\0';
+	p = host;
+	if (*p == '[') {
+		p = strchr(host, ']');
+		if (!p) {
+			lws_log(LWS_LOG_EMERG, "bad runtime API address:%s", host);
+			return NULL;
+		}
+		*p++ = '\0';
+		port = *p == ':' ? p + 1 : "80";
+		p = host + 1;
+	} else {
+		port = strrchr(host, ':');
+		if (port) {
+			*port++ = '\0';
+		} else {
+			port = "80";
+		}
+	}
+
+	/* resolve once */
+	lws_memzero(&hints, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICSERV;
+	if ((rc = getaddrinfo(p, port, &hints, &res)) != 0) {
+		lws_log(LWS_LOG_EMERG, "failed to resolve runtime API host:%s port:%s: %s", p, port,
+				gai_strerror(rc));
+		return NULL;
+	}
+	c = lws_calloc(sizeof(lws_client_t));
+	if (!c) {
+		freeaddrinfo(res);
+		return NULL;
+	}
+	c->next_conn.fd = -1;
+	c->post_conn.fd = -1;
+	c->conn = &c->next_conn;
+	c->loop = loop;
+	memcpy(&c->addr, res->ai_addr, res->ai_addrlen);
+	c->addr_len = res->ai_addrlen;
+	freeaddrinfo(res);
+
+	/* preformat requests */
+	if (lws_client_format(&c->next, "GET /%s/runtime/invocation/next HTTP/1.1\r\n"
+			"Host: %.*s\r\nUser-Agent: %s\r\nAccept: */*\r\n\r\n", LWS_LAMBDA_RUNTIME_VERSION,
+			(int)runtime_api->len, runtime_api->data, LWS_USERAGENT) != 0
+			|| lws_client_format(&c->invocation, "POST /%s/runtime/invocation/",
+			LWS_LAMBDA_RUNTIME_VERSION) != 0
+			|| lws_client_format(&c->response, "/response HTTP/1.1\r\nHost: %.*s\r\n"
+			"User-Agent: %s\r\n", (int)runtime_api->len, runtime_api->data, LWS_USERAGENT) != 0
+			|| lws_client_format(&c->error, "/error HTTP/1.1\r\nHost: %.*s\r\n"
+			"User-Agent: %s\r\n", (int)runtime_api->len, runtime_api->data, LWS_USERAGENT) != 0
+			|| lws_client_format(&c->init_error, "POST /%s/runtime/init/error HTTP/1.1\r\n"
+			"Host: %.*s\r\nUser-Agent: %s\r\n", LWS_LAMBDA_RUNTIME_VERSION,
+			(int)runtime_api->len, runtime_api->data, LWS_USERAGENT) != 0) {
+		goto error;
+	}
+
+	/* buffers */
+	if (lws_client_alloc_buf(&c->head, LWS_CLIENT_HEAD_SIZE) != 0
+			|| lws_client_alloc_buf(&c->in, LWS_CLIENT_IN_SIZE) != 0
+			|| lws_client_alloc_buf(&c->out, LWS_CLIENT_OUT_SIZE) != 0) {
+		goto error;
+	}
+
+	return c;
+
+	error:
+	lws_client_free(c);
+	return NULL;
+}
+
+void lws_client_free (lws_client_t *c) {
+	c->conn = &c->post_conn;
+	lws_client_close(c);
+	c->conn = &c->next_conn;
+	lws_client_close(c);
+	lws_free(c->next.data);
+	lws_free(c->invocation.data);
+	lws_free(c->response.data);
+	lws_free(c->error.data);
+	lws_free(c->init_error.data);
+	lws_free(c->head.data);
+	lws_free(c->in.data);
+	lws_free(c->out.data);
+	lws_free(c);
+}
+
+int lws_client_get_next (lws_ctx_t *ctx) {
+	int            rc, sent;
+	lws_client_t  *c;
+	struct iovec   iov[1];
+
+	c = ctx->client;
+	c->conn = &c->next_conn;
+	sent = c->next_sent;
+	c->next_sent = 0;
+	iov[0].iov_base = c->next.data;
+	iov[0].iov_len = c->next.len;
+	c->polling = 1;
+	c->cancelled = 0;
+	rc = lws_client_exchange(ctx, iov, 1, 1, sent);
+	c->polling = 0;
+	return rc;
+}
+
+int lws_client_post (lws_ctx_t *ctx, lws_client_target_e target, const char *headers,
+		const struct iovec *body, int bodycnt) {
+	int           n, i;
+	char          content_length[48];
+	size_t        len;
+	struct iovec  iov[8];
+
+	if (bodycnt > 3) {
+		lws_log(LWS_LOG_ERR, "too many body parts");
+		return -1;
+	}
+	len = 0;
+	for (i = 0; i < bodycnt; i++) {
+		len += body[i].iov_len;
+	}
+	lws_client_select(ctx, target);
+	n = lws_client_target(ctx, target, iov);
+	iov[n].iov_base = (char *)headers;
+	iov[n++].iov_len = strlen(headers);
+	iov[n].iov_base = content_length;
+	iov[n++].iov_len = (size_t)snprintf(content_length, sizeof(content_length),
+			"Content-Length: %zu\r\n\r\n", len);
+	for (i = 0; i < bodycnt; i++) {
+		iov[n++] = body[i];
+	}
+	return lws_client_exchange(ctx, iov, n, 0, 0);
+}
+
+int lws_client_begin (lws_ctx_t *ctx, lws_client_target_e target, const char *headers,
+		off_t length) {
+	int            n;
+	char           content_length[48];
+	lws_client_t  *c;
+	struct iovec   iov[5];
+
+	/* a streaming request cannot be retried; ensure the connection is live */
+	c = ctx->client;
+	lws_client_select(ctx, target);
+	if (c->conn->fd >= 0 && lws_client_closed(c)) {
+		lws_log_debug("replacing stale connection");
+		lws_client_close(c);
+	}
+	if (c->conn->fd < 0 && lws_client_connect(c) != 0) {
+		return -1;
+	}
+	c->conn->requests++;
+
+	/* send request header */
+	n = lws_client_target(ctx, target, iov);
+	iov[n].iov_base = (char *)headers;
+	iov[n++].iov_len = strlen(headers);
+	if (length >= 0) {
+		iov[n].iov_base = content_length;
+		iov[n++].iov_len = (size_t)snprintf(content_length, sizeof(content_length),
+				"Content-Length: %lld\r\n\r\n", (long long)length);
+	} else {
+		iov[n].iov_base = LWS_CLIENT_CHUNKED;
+		iov[n++].iov_len = sizeof(LWS_CLIENT_CHUNKED) - 1;
+	}
+	if (lws_client_send(c, iov, n) != 0) {
+		lws_log(LWS_LOG_CRIT, "failed to send runtime API request: %s", strerror(errno));
+		lws_client_close(c);
+		return -1;
+	}
+	c->streaming = 1;
+	c->chunked = length < 0;
+	return 0;
+}
+
+int lws_client_stream (lws_ctx_t *ctx, lws_client_read_pt read, void *userdata, int finalize) {
+	int                 hl;
+	char               *data, head[LWS_CLIENT_CHUNK_HEAD];
+	size_t              n;
+	lws_client_t       *c;
+	struct iovec        iov[1];
+	lws_client_resp_t   resp;
+
+	c = ctx->client;
+	if (!c->streaming) {
+		lws_log(LWS_LOG_ERR, "no streaming request");
+		return -1;
+	}
+
+	/* send chunks until paused or done */
+	data = c->out.data + LWS_CLIENT_CHUNK_HEAD;
+	while (1) {
+		n = read(data, 1, c->out.cap - LWS_CLIENT_CHUNK_HEAD - 2, userdata);
+		if (n == CURL_READFUNC_PAUSE) {
+			if (!finalize) {
+				return 0;
+			}
+			lws_log(LWS_LOG_ERR, "streaming paused while finalizing");
+			goto error;
+		}
+		if (n == CURL_READFUNC_ABORT) {
+			goto error;
+		}
+		if (n == 0) {
+			break;
+		}
+		if (c->chunked) {
+			hl = snprintf(head, sizeof(head), "%zx\r\n", n);
+			memcpy(data - hl, head, (size_t)hl);
+			memcpy(data + n, "\r\n", 2);
+			iov[0].iov_base = data - hl;
+			iov[0].iov_len = (size_t)hl + n + 2;
+		} else {
+			iov[0].iov_base = data;
+			iov[0].iov_len = n;
+		}
+		if (lws_client_send(c, iov, 1) != 0) {
+			lws_log(LWS_LOG_CRIT, "failed to send runtime API request: %s", strerror(errno));
+			goto error;
+		}
+	}
+
+	/* last chunk and response */
+	iov[0].iov_base = "0\r\n\r\n";
+	iov[0].iov_len = 5;
+	if (c->chunked && lws_client_send(c, iov, 1) != 0) {
+		lws_log(LWS_LOG_CRIT, "failed to send runtime API request: %s", strerror(errno));
+		goto error;
+	}
+	c->streaming = 0;
+	if (ctx->overlap && c->conn == &c->post_conn) {
+		lws_client_send_next(ctx);
+	}
+	if (lws_client_read_response(ctx, 0, &resp) != 0) {
+		lws_log(LWS_LOG_CRIT, "failed to read runtime API response");
+		goto error;
+	}
+	if (resp.status < 200 || resp.status >= 300) {
+		lws_log(LWS_LOG_CRIT, "bad HTTP status code:%d", resp.status);
+		return -1;
+	}
+	return 0;
+
+	error:
+	lws_client_close(c);
+	return -1;
+}
+
+void lws_client_abort (lws_client_t *c) {
+	if (c->streaming) {
+		lws_client_close(c);  /* a partial request cannot be completed */
+	}
+}
@@ -0,0 +1,93 @@
+/*
+ * LWS native runtime API client
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#ifndef _LWS_CLIENT_INCLUDED
+#define _LWS_CLIENT_INCLUDED
+
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+
+#ifndef LWS_CLIENT_HEADERS_MAX
+#define LWS_CLIENT_HEADERS_MAX  64
+#endif
+
+
+typedef struct lws_client_s lws_client_t;
+typedef struct lws_client_buf_s lws_client_buf_t;
+typedef struct lws_client_conn_s lws_client_conn_t;
+
+typedef enum {
+	LWS_HTTP_CLIENT_CURL,
+	LWS_HTTP_CLIENT_NATIVE
+} lws_http_client_e;
+
+typedef enum {
+	LWS_CLIENT_RESPONSE,
+	LWS_CLIENT_ERROR,
+	LWS_CLIENT_INIT_ERROR
+} lws_client_target_e;
+
+typedef size_t (*lws_client_read_pt)(char *ptr, size_t size, size_t nmemb, void *userdata);
+
+
+#include <lws_runtime.h>
+
+
+struct lws_client_buf_s {
+	char    *data;  /* data */
+	size_t   len;   /* length */
+	size_t   pos;   /* read position */
+	size_t   cap;   /* capacity */
+};
+
+struct lws_client_conn_s {
+	int        fd;        /* socket; -1 if not connected */
+	lws_int_t  requests;  /* requests on connection */
+};
+
+struct lws_client_s {
+	lws_client_conn_t      *conn;                            /* current connection */
+	lws_client_conn_t       next_conn;                       /* next invocation connection */
+	lws_client_conn_t       post_conn;                       /* response connection if overlapping */
+	struct sockaddr_storage addr;                            /* runtime API address */
+	socklen_t               addr_len;                        /* runtime API address length */
+	lws_str_t               next;                            /* next invocation request */
+	lws_str_t               invocation;                      /* invocation request prefix */
+	lws_str_t               response;                        /* response request suffix */
+	lws_str_t               error;                           /* error request suffix */
+	lws_str_t               init_error;                      /* init error request line */
+	lws_client_buf_t        head;                            /* next invocation header block */
+	lws_client_buf_t        in;                              /* input stream */
+	lws_client_buf_t        out;                             /* streaming chunk buffer */
+	lws_str_t               values[LWS_CLIENT_HEADERS_MAX];  /* header values */
+	unsigned                streaming:1;                     /* streaming request open */
+	unsigned                chunked:1;                       /* ... with chunked encoding */
+	unsigned                next_sent:1;                     /* next invocation request sent */
+	unsigned                next_reused:1;                   /* ... on a reused connection */
+	unsigned                polling:1;                       /* polling for the next invocation */
+	unsigned                cancelled:1;                     /* poll cancelled */
+	lws_loop_t             *loop;                            /* event loop */
+};
+
+
+extern lws_str_t lws_http_clients[];
+
+
+lws_client_t *lws_client_create(lws_str_t *runtime_api, lws_loop_t *loop);
+void lws_client_free(lws_client_t *client);
+int lws_client_get_next(lws_ctx_t *ctx);
+int lws_client_post(lws_ctx_t *ctx, lws_client_target_e target, const char *headers,
+		const struct iovec *body, int bodycnt);
+int lws_client_begin(lws_ctx_t *ctx, lws_client_target_e target, const char *headers,
+		off_t length);
+int lws_client_stream(lws_ctx_t *ctx, lws_client_read_pt read, void *userdata, int finalize);
+void lws_client_abort(lws_client_t *client);
+
+
+#endif /* _LWS_CLIENT_INCLUDED */
@@ -7,7 +7,11 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <lws_codec.h>
+#if LWS_CODEC_X86
+#include <immintrin.h>
+#endif
 
 
 #ifndef __has_builtin
@@ -17,9 +21,6 @@
 #define __builtin_expect(x, y)  (x)
 #endif
 
-#define LWS_UTF8_ACCEPT  0
-#define LWS_UTF8_REJECT  12
-
 
 static const uint8_t b64_dec_tbl[256] = {
 	0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80, /* 0x00-0x0F */ 
@@ -34,6 +35,35 @@ static const uint8_t b64_dec_tbl[256] = {
 };
 static const char b64_enc_tbl[64] =
 		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const uint8_t json_esc_tbl[256] = {
+	6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,2   ,2   ,2   ,6   ,2   ,2   ,6   ,6   , /* 0x00-0x0F */
+	6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   ,6   , /* 0x10-0x1F */
+	1   ,1   ,2   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   , /* 0x20-0x2F */
+	1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   , /* 0x30-0x3F */
+	1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   , /* 0x40-0x4F */
+	1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,2   ,1   ,1   ,1   , /* 0x50-0x5F */
+	1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   , /* 0x60-0x6F */
+	1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   ,1   , /* 0x70-0x7F */
+	[0x80 ... 0xFF] = 1                                                              /* 0x80-0xFF */
+};
+static const char hex_tbl[16] = "0123456789abcdef";
+#if LWS_CODEC_X86
+static const uint8_t utf8_prev1_high[16] = {
+	0x02,0x02,0x02,0x02,0x02,0x02,0x02,0x02,0x80,0x80,0x80,0x80,0x21,0x01,0x15,0x49
+};
+static const uint8_t utf8_prev1_low[16] = {
+	0xe7,0xa3,0x83,0x83,0x8b,0xcb,0xcb,0xcb,0xcb,0xcb,0xcb,0xcb,0xcb,0xdb,0xcb,0xcb
+};
+static const uint8_t utf8_high[16] = {
+	0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0xe6,0xae,0xba,0xba,0x01,0x01,0x01,0x01
+};
+static const uint8_t b64_dec_pack[64] = {
+	2,1,0,6,5,4,10,9,8,14,13,12,18,17,16,22,
+	21,20,26,25,24,30,29,28,34,33,32,38,37,36,42,41,
+	40,46,45,44,50,49,48,54,53,52,58,57,56,62,61,60,
+	[48 ... 63] = 0
+};
+#endif
 
 /*
 Copyright (c) 2008-2009 Bjoern Hoehrmann <bjoern@hoehrmann.de>
@@ -78,12 +108,595 @@ static const uint8_t utf8d[] = {
 };
 
 
+/*
+ * codec kernels
+ */
+
+typedef size_t (*lws_base64_decode_pt)(const uint8_t *src, size_t len, uint8_t *dst);
+typedef size_t (*lws_base64_encode_pt)(uint8_t *in_out, size_t len);
+typedef size_t (*lws_base64_encode_to_pt)(const uint8_t *in, size_t len, uint8_t *out);
+typedef int (*lws_utf8_pt)(const uint8_t *p, size_t n, size_t *len, size_t *extra);
+typedef size_t (*lws_json_span_pt)(const uint8_t *p, size_t n);
+
+typedef struct lws_codec_kernel_s {
+	lws_base64_decode_pt     decode;     /* decodes leading 4-char blocks; returns input consumed */
+	lws_base64_encode_pt     encode;     /* encodes trailing 3-byte blocks in place; returns input left */
+	lws_base64_encode_to_pt  encode_to;  /* encodes leading 3-byte blocks; returns input consumed */
+	lws_utf8_pt              utf8;       /* validates a prefix ending at a code point boundary */
+	lws_json_span_pt         json_span;  /* returns the leading length needing no JSON escape */
+} lws_codec_kernel_t;
+
+static size_t lws_base64_decode_scalar(const uint8_t *src, size_t len, uint8_t *dst);
+static size_t lws_base64_encode_scalar(uint8_t *in_out, size_t len);
+static size_t lws_base64_encode_to_scalar(const uint8_t *in, size_t len, uint8_t *out);
+static int lws_utf8_scalar(const uint8_t *p, size_t n, size_t *len, size_t *extra);
+static size_t lws_json_span_scalar(const uint8_t *p, size_t n);
+#if LWS_CODEC_X86
+static size_t lws_base64_decode_ssse3(const uint8_t *src, size_t len, uint8_t *dst);
+static size_t lws_base64_encode_ssse3(uint8_t *in_out, size_t len);
+static size_t lws_base64_encode_to_ssse3(const uint8_t *in, size_t len, uint8_t *out);
+static int lws_utf8_ssse3(const uint8_t *p, size_t n, size_t *len, size_t *extra);
+static size_t lws_json_span_ssse3(const uint8_t *p, size_t n);
+static size_t lws_base64_decode_avx2(const uint8_t *src, size_t len, uint8_t *dst);
+static size_t lws_base64_encode_avx2(uint8_t *in_out, size_t len);
+static size_t lws_base64_encode_to_avx2(const uint8_t *in, size_t len, uint8_t *out);
+static int lws_utf8_avx2(const uint8_t *p, size_t n, size_t *len, size_t *extra);
+static size_t lws_json_span_avx2(const uint8_t *p, size_t n);
+static size_t lws_base64_decode_avx512(const uint8_t *src, size_t len, uint8_t *dst);
+static size_t lws_base64_encode_avx512(uint8_t *in_out, size_t len);
+static size_t lws_base64_encode_to_avx512(const uint8_t *in, size_t len, uint8_t *out);
+#endif
+
+static const lws_codec_kernel_t codec_kernels[] = {
+	{ lws_base64_decode_scalar, lws_base64_encode_scalar, lws_base64_encode_to_scalar,
+			lws_utf8_scalar, lws_json_span_scalar },
+#if LWS_CODEC_X86
+	{ lws_base64_decode_ssse3, lws_base64_encode_ssse3, lws_base64_encode_to_ssse3,
+			lws_utf8_ssse3, lws_json_span_ssse3 },
+	{ lws_base64_decode_avx2, lws_base64_encode_avx2, lws_base64_encode_to_avx2,
+			lws_utf8_avx2, lws_json_span_avx2 },
+	{ lws_base64_decode_avx512, lws_base64_encode_avx512, lws_base64_encode_to_avx512,
+			lws_utf8_avx2, lws_json_span_avx2 },
+#endif
+};
+static const char *codec_kernel_names[] = { "scalar", "ssse3", "avx2", "avx512vbmi" };
+static const lws_codec_kernel_t *codec_kernel = &codec_kernels[LWS_CODEC_SCALAR];
+
+
+static size_t lws_base64_decode_scalar (const uint8_t *src, size_t len, uint8_t *dst) {
+	return 0;
+}
+
+static size_t lws_base64_encode_scalar (uint8_t *in_out, size_t len) {
+	return len;
+}
+
+static size_t lws_base64_encode_to_scalar (const uint8_t *in, size_t len, uint8_t *out) {
+	return 0;
+}
+
+static int lws_utf8_scalar (const uint8_t *p, size_t n, size_t *len, size_t *extra) {
+	*len = 0;
+	if (extra) {
+		*extra = 0;
+	}
+	return 0;
+}
+
+static size_t lws_json_span_scalar (const uint8_t *p, size_t n) {
+	size_t  i;
+
+	for (i = 0; i < n && json_esc_tbl[p[i]] == 1; i++);
+	return i;
+}
+
+#if LWS_CODEC_X86
+
+/*
+ * The base64 kernels follow the pshufb/multishift schemes by Wojciech Mula and
+ * Daniel Lemire. Decoding processes whole vectors of valid characters and
+ * stops at the first vector containing anything else (including padding),
+ * leaving the remainder and the error to the scalar path. In-place encoding
+ * loads each vector ending at the current input position so that the chunk is
+ * right-aligned; the output never overtakes unread input.
+ */
+
+__attribute__((target("ssse3")))
+static inline __m128i lws_base64_enc_ssse3 (__m128i in, int offset) {
+	__m128i  t0, t1, t2, t3, idx, res;
+
+	in  = _mm_shuffle_epi8(in, _mm_add_epi8(_mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7,
+			10, 9, 11, 10), _mm_set1_epi8((char)offset)));
+	t0  = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	t1  = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	t2  = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	t3  = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	idx = _mm_or_si128(t1, t3);
+	res = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	res = _mm_or_si128(res, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx),
+			_mm_set1_epi8(13)));
+	res = _mm_shuffle_epi8(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,
+			'A', 0, 0), res);
+	return _mm_add_epi8(res, idx);
+}
+
+__attribute__((target("ssse3")))
+static inline int lws_base64_dec_ssse3 (__m128i in, __m128i *out) {
+	__m128i  hi, lo, roll;
+
+	hi = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+	lo = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+	lo = _mm_shuffle_epi8(_mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a), lo);
+	roll = _mm_add_epi8(_mm_cmpeq_epi8(in, _mm_set1_epi8(0x2f)), hi);
+	hi = _mm_shuffle_epi8(_mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10), hi);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128()))
+			!= 0xffff) {
+		return -1;
+	}
+	roll = _mm_shuffle_epi8(_mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0,
+			0, 0), roll);
+	in = _mm_add_epi8(in, roll);
+	in = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+	*out = _mm_madd_epi16(in, _mm_set1_epi32(0x00011000));
+	return 0;
+}
+
+__attribute__((target("ssse3")))
+static size_t lws_base64_decode_ssse3 (const uint8_t *src, size_t len, uint8_t *dst) {
+	size_t    in;
+	uint32_t  tail;
+	__m128i   v;
+
+	for (in = 0; len - in >= 16; in += 16) {
+		if (lws_base64_dec_ssse3(_mm_loadu_si128((const __m128i *)(src + in)), &v) != 0) {
+			break;
+		}
+		v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+				-1, -1, -1, -1));
+		_mm_storel_epi64((__m128i *)dst, v);
+		tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+		memcpy(dst + 8, &tail, 4);
+		dst += 12;
+	}
+	return in;
+}
+
+__attribute__((target("ssse3")))
+static size_t lws_base64_encode_ssse3 (uint8_t *in_out, size_t len) {
+	size_t  out;
+
+	out = len / 3 * 4;
+	while (len >= 16) {
+		_mm_storeu_si128((__m128i *)(in_out + out - 16), lws_base64_enc_ssse3(
+				_mm_loadu_si128((const __m128i *)(in_out + len - 16)), 4));
+		len -= 12;
+		out -= 16;
+	}
+	return len;
+}
+
+__attribute__((target("ssse3")))
+static size_t lws_base64_encode_to_ssse3 (const uint8_t *in, size_t len, uint8_t *out) {
+	size_t  i;
+
+	for (i = 0; len - i >= 16; i += 12) {
+		_mm_storeu_si128((__m128i *)out, lws_base64_enc_ssse3(
+				_mm_loadu_si128((const __m128i *)(in + i)), 0));
+		out += 16;
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i lws_base64_enc_avx2 (__m256i in, int offset) {
+	__m256i  t0, t1, t2, t3, idx, res;
+
+	in  = _mm256_permutevar8x32_epi32(in, _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 2,
+			3, 4, 5, 5), _mm256_set1_epi32(offset)));
+	in  = _mm256_shuffle_epi8(in, _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7,
+			10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	t0  = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+	t1  = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+	t2  = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+	t3  = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+	idx = _mm256_or_si256(t1, t3);
+	res = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+	res = _mm256_or_si256(res, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx),
+			_mm256_set1_epi8(13)));
+	res = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_setr_epi8('a' - 26, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '+' - 62, '/' - 63, 'A', 0, 0)), res);
+	return _mm256_add_epi8(res, idx);
+}
+
+__attribute__((target("avx2")))
+static inline int lws_base64_dec_avx2 (__m256i in, __m256i *out) {
+	__m256i  hi, lo, roll;
+
+	hi = _mm256_and_si256(_mm256_srli_epi32(in, 4), _mm256_set1_epi8(0x0f));
+	lo = _mm256_and_si256(in, _mm256_set1_epi8(0x0f));
+	lo = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_setr_epi8(0x15, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a)), lo);
+	roll = _mm256_add_epi8(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(0x2f)), hi);
+	hi = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_setr_epi8(0x10, 0x10, 0x01, 0x02,
+			0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10)), hi);
+	if (!_mm256_testz_si256(lo, hi)) {
+		return -1;
+	}
+	roll = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_setr_epi8(0, 16, 19, 4, -65,
+			-65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0)), roll);
+	in = _mm256_add_epi8(in, roll);
+	in = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+	*out = _mm256_madd_epi16(in, _mm256_set1_epi32(0x00011000));
+	return 0;
+}
+
+__attribute__((target("avx2")))
+static size_t lws_base64_decode_avx2 (const uint8_t *src, size_t len, uint8_t *dst) {
+	size_t   in;
+	__m256i  v;
+
+	for (in = 0; len - in >= 32; in += 32) {
+		if (lws_base64_dec_avx2(_mm256_loadu_si256((const __m256i *)(src + in)), &v) != 0) {
+			break;
+		}
+		v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+				-1, -1, -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(v));
+		_mm_storel_epi64((__m128i *)(dst + 16), _mm256_extracti128_si256(v, 1));
+		dst += 24;
+	}
+	return in + lws_base64_decode_ssse3(src + in, len - in, dst);
+}
+
+__attribute__((target("avx2")))
+static size_t lws_base64_encode_avx2 (uint8_t *in_out, size_t len) {
+	size_t  out;
+
+	out = len / 3 * 4;
+	while (len >= 32) {
+		_mm256_storeu_si256((__m256i *)(in_out + out - 32), lws_base64_enc_avx2(
+				_mm256_loadu_si256((const __m256i *)(in_out + len - 32)), 2));
+		len -= 24;
+		out -= 32;
+	}
+	return lws_base64_encode_ssse3(in_out, len);
+}
+
+__attribute__((target("avx2")))
+static size_t lws_base64_encode_to_avx2 (const uint8_t *in, size_t len, uint8_t *out) {
+	size_t  i;
+
+	for (i = 0; len - i >= 32; i += 24) {
+		_mm256_storeu_si256((__m256i *)out, lws_base64_enc_avx2(
+				_mm256_loadu_si256((const __m256i *)(in + i)), 0));
+		out += 32;
+	}
+	return i + lws_base64_encode_to_ssse3(in + i, len - i, out);
+}
+
+__attribute__((target("avx2,avx512f,avx512bw,avx512vbmi")))
+static inline __m512i lws_base64_enc_avx512 (__m512i in, int offset) {
+	__m512i  idx;
+
+	idx = _mm512_add_epi8(_mm512_setr_epi32(0x01020001, 0x04050304, 0x07080607, 0x0a0b090a,
+			0x0d0e0c0d, 0x10110f10, 0x13141213, 0x16171516, 0x191a1819, 0x1c1d1b1c,
+			0x1f201e1f, 0x22232122, 0x25262425, 0x28292728, 0x2b2c2a2b, 0x2e2f2d2e),
+			_mm512_set1_epi8((char)offset));
+	in  = _mm512_permutexvar_epi8(idx, in);
+	idx = _mm512_multishift_epi64_epi8(_mm512_set1_epi64(0x3036242a1016040a), in);
+	return _mm512_permutexvar_epi8(idx, _mm512_loadu_si512((const void *)b64_enc_tbl));
+}
+
+__attribute__((target("avx2,avx512f,avx512bw,avx512vbmi")))
+static size_t lws_base64_decode_avx512 (const uint8_t *src, size_t len, uint8_t *dst) {
+	size_t   in;
+	__m512i  v, t;
+
+	for (in = 0; len - in >= 64; in += 64) {
+		v = _mm512_loadu_si512((const void *)(src + in));
+		t = _mm512_permutex2var_epi8(_mm512_loadu_si512((const void *)b64_dec_tbl), v,
+				_mm512_loadu_si512((const void *)(b64_dec_tbl + 64)));
+		if (_mm512_movepi8_mask(_mm512_or_si512(t, v))) {
+			break;
+		}
+		t = _mm512_maddubs_epi16(t, _mm512_set1_epi32(0x01400140));
+		t = _mm512_madd_epi16(t, _mm512_set1_epi32(0x00011000));
+		t = _mm512_permutexvar_epi8(_mm512_loadu_si512((const void *)b64_dec_pack), t);
+		_mm512_mask_storeu_epi8(dst, 0xffffffffffffULL, t);
+		dst += 48;
+	}
+	return in + lws_base64_decode_avx2(src + in, len - in, dst);
+}
+
+__attribute__((target("avx2,avx512f,avx512bw,avx512vbmi")))
+static size_t lws_base64_encode_avx512 (uint8_t *in_out, size_t len) {
+	size_t  out;
+
+	out = len / 3 * 4;
+	while (len >= 64) {
+		_mm512_storeu_si512((void *)(in_out + out - 64), lws_base64_enc_avx512(
+				_mm512_loadu_si512((const void *)(in_out + len - 64)), 16));
+		len -= 48;
+		out -= 64;
+	}
+	return lws_base64_encode_avx2(in_out, len);
+}
+
+__attribute__((target("avx2,avx512f,avx512bw,avx512vbmi")))
+static size_t lws_base64_encode_to_avx512 (const uint8_t *in, size_t len, uint8_t *out) {
+	size_t  i;
+
+	for (i = 0; len - i >= 64; i += 48) {
+		_mm512_storeu_si512((void *)out, lws_base64_enc_avx512(
+				_mm512_loadu_si512((const void *)(in + i)), 0));
+		out += 64;
+	}
+	return i + lws_base64_encode_to_avx2(in + i, len - i, out);
+}
+
+/*
+ * The UTF-8 kernels implement the lookup algorithm by John Keiser and Daniel
+ * Lemire, which checks each byte against its three predecessors with nibble
+ * lookups and skips pure ASCII blocks. Validation stops short of a sequence
+ * left incomplete at the end of the last vector; the caller finishes it with
+ * the DFA, which also carries the state across calls. Given an extra
+ * argument, they also sum the bytes that JSON escaping adds to the prefix,
+ * fusing the escaped length into the validation pass.
+ */
+
+static inline size_t lws_utf8_boundary (const uint8_t *p, size_t i, int incomplete) {
+	if (incomplete) {
+		/* back up to the lead byte of the trailing sequence */
+		do {
+			i--;
+		} while (p[i] < 0xc0);
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i lws_utf8_check_ssse3 (__m128i in, __m128i prev) {
+	__m128i  prev1, nib, sc, must23;
+
+	prev1  = _mm_alignr_epi8(in, prev, 15);
+	nib    = _mm_set1_epi8(0x0f);
+	sc     = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)utf8_prev1_high),
+			_mm_and_si128(_mm_srli_epi16(prev1, 4), nib));
+	sc     = _mm_and_si128(sc, _mm_shuffle_epi8(_mm_loadu_si128(
+			(const __m128i *)utf8_prev1_low), _mm_and_si128(prev1, nib)));
+	sc     = _mm_and_si128(sc, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)utf8_high),
+			_mm_and_si128(_mm_srli_epi16(in, 4), nib)));
+	must23 = _mm_or_si128(_mm_subs_epu8(_mm_alignr_epi8(in, prev, 14), _mm_set1_epi8(0x60)),
+			_mm_subs_epu8(_mm_alignr_epi8(in, prev, 13), _mm_set1_epi8(0x70)));
+	return _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8((char)0x80)), sc);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i lws_json_esc_ssse3 (__m128i in, __m128i *ctl) {
+	*ctl = _mm_cmpeq_epi8(_mm_max_epu8(in, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f));
+	return _mm_or_si128(*ctl, _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('"')),
+			_mm_cmpeq_epi8(in, _mm_set1_epi8('\\'))));
+}
+
+__attribute__((target("ssse3")))
+static inline size_t lws_json_extra_ssse3 (__m128i in) {
+	__m128i  esc, ctl, shrt;
+
+	/* 1 extra byte per escape, 4 more per control character without a short escape */
+	esc  = lws_json_esc_ssse3(in, &ctl);
+	shrt = _mm_and_si128(_mm_shuffle_epi8(_mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, 0,
+			-1, -1, 0, 0), in), _mm_cmpeq_epi8(_mm_max_epu8(in, _mm_set1_epi8(0x0f)),
+			_mm_set1_epi8(0x0f)));
+	return (size_t)__builtin_popcount(_mm_movemask_epi8(esc))
+			+ 4 * (size_t)__builtin_popcount(_mm_movemask_epi8(_mm_andnot_si128(shrt, ctl)));
+}
+
+__attribute__((target("ssse3")))
+static int lws_utf8_ssse3 (const uint8_t *p, size_t n, size_t *len, size_t *extra) {
+	int      incomplete;
+	size_t   i, esc;
+	__m128i  in, prev, ctl, zero;
+
+	zero = _mm_setzero_si128();
+	prev = zero;
+	incomplete = 0;
+	esc = 0;
+	for (i = 0; n - i >= 16; i += 16) {
+		in = _mm_loadu_si128((const __m128i *)(p + i));
+		if (extra && _mm_movemask_epi8(lws_json_esc_ssse3(in, &ctl))) {
+			esc += lws_json_extra_ssse3(in);
+		}
+		if (!_mm_movemask_epi8(in)) {
+			/* ASCII block */
+			if (incomplete) {
+				return -1;
+			}
+			continue;
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(lws_utf8_check_ssse3(in, prev), zero)) != 0xffff) {
+			return -1;
+		}
+		incomplete = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(in, _mm_setr_epi8(-1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)0xef, (char)0xdf,
+				(char)0xbf)), zero)) != 0xffff;
+		prev = in;
+	}
+	*len = lws_utf8_boundary(p, i, incomplete);
+	if (extra) {
+		*extra = esc;
+	}
+	return 0;
+}
+
+__attribute__((target("ssse3")))
+static size_t lws_json_span_ssse3 (const uint8_t *p, size_t n) {
+	int      mask;
+	size_t   i;
+	__m128i  ctl;
+
+	for (i = 0; n - i >= 16; i += 16) {
+		mask = _mm_movemask_epi8(lws_json_esc_ssse3(_mm_loadu_si128((const __m128i *)(p + i)),
+				&ctl));
+		if (mask) {
+			return i + (size_t)__builtin_ctz((unsigned)mask);
+		}
+	}
+	return i + lws_json_span_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i lws_utf8_check_avx2 (__m256i in, __m256i prev) {
+	__m256i  carry, prev1, nib, sc, must23;
+
+	carry  = _mm256_permute2x128_si256(prev, in, 0x21);
+	prev1  = _mm256_alignr_epi8(in, carry, 15);
+	nib    = _mm256_set1_epi8(0x0f);
+	sc     = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128(
+			(const __m128i *)utf8_prev1_high)), _mm256_and_si256(_mm256_srli_epi16(prev1, 4),
+			nib));
+	sc     = _mm256_and_si256(sc, _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *)utf8_prev1_low)), _mm256_and_si256(prev1, nib)));
+	sc     = _mm256_and_si256(sc, _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *)utf8_high)), _mm256_and_si256(
+			_mm256_srli_epi16(in, 4), nib)));
+	must23 = _mm256_or_si256(_mm256_subs_epu8(_mm256_alignr_epi8(in, carry, 14),
+			_mm256_set1_epi8(0x60)), _mm256_subs_epu8(_mm256_alignr_epi8(in, carry, 13),
+			_mm256_set1_epi8(0x70)));
+	return _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8((char)0x80)), sc);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i lws_json_esc_avx2 (__m256i in, __m256i *ctl) {
+	*ctl = _mm256_cmpeq_epi8(_mm256_max_epu8(in, _mm256_set1_epi8(0x1f)),
+			_mm256_set1_epi8(0x1f));
+	return _mm256_or_si256(*ctl, _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('"')),
+			_mm256_cmpeq_epi8(in, _mm256_set1_epi8('\\'))));
+}
+
+__attribute__((target("avx2,popcnt")))
+static inline size_t lws_json_extra_avx2 (__m256i in) {
+	__m256i  esc, ctl, shrt;
+
+	esc  = lws_json_esc_avx2(in, &ctl);
+	shrt = _mm256_and_si256(_mm256_shuffle_epi8(_mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, -1,
+			-1, -1, 0, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, 0, -1, -1, 0, 0), in),
+			_mm256_cmpeq_epi8(_mm256_max_epu8(in, _mm256_set1_epi8(0x0f)),
+			_mm256_set1_epi8(0x0f)));
+	return (size_t)_mm_popcnt_u32((unsigned)_mm256_movemask_epi8(esc)) + 4
+			* (size_t)_mm_popcnt_u32((unsigned)_mm256_movemask_epi8(
+			_mm256_andnot_si256(shrt, ctl)));
+}
+
+__attribute__((target("avx2,popcnt")))
+static int lws_utf8_avx2 (const uint8_t *p, size_t n, size_t *len, size_t *extra) {
+	int      incomplete;
+	size_t   i, tail, esc;
+	__m256i  in, prev, ctl, err;
+
+	prev = _mm256_setzero_si256();
+	incomplete = 0;
+	esc = 0;
+	for (i = 0; n - i >= 32; i += 32) {
+		in = _mm256_loadu_si256((const __m256i *)(p + i));
+		if (extra && _mm256_movemask_epi8(lws_json_esc_avx2(in, &ctl))) {
+			esc += lws_json_extra_avx2(in);
+		}
+		if (!_mm256_movemask_epi8(in)) {
+			/* ASCII block */
+			if (incomplete) {
+				return -1;
+			}
+			continue;
+		}
+		err = lws_utf8_check_avx2(in, prev);
+		if (!_mm256_testz_si256(err, err)) {
+			return -1;
+		}
+		err = _mm256_subs_epu8(in, _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				(char)0xef, (char)0xdf, (char)0xbf));
+		incomplete = !_mm256_testz_si256(err, err);
+		prev = in;
+	}
+
+	/* a trailing incomplete sequence continues into the SSSE3 tail; it adds no escapes */
+	i = lws_utf8_boundary(p, i, incomplete);
+	if (lws_utf8_ssse3(p + i, n - i, &tail, extra) != 0) {
+		return -1;
+	}
+	*len = i + tail;
+	if (extra) {
+		*extra += esc;
+	}
+	return 0;
+}
+
+__attribute__((target("avx2")))
+static size_t lws_json_span_avx2 (const uint8_t *p, size_t n) {
+	unsigned  mask;
+	size_t    i;
+	__m256i   ctl;
+
+	for (i = 0; n - i >= 32; i += 32) {
+		mask = (unsigned)_mm256_movemask_epi8(lws_json_esc_avx2(_mm256_loadu_si256(
+				(const __m256i *)(p + i)), &ctl));
+		if (mask) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+	}
+	return i + lws_json_span_ssse3(p + i, n - i);
+}
+
+#endif /* LWS_CODEC_X86 */
+
+lws_codec_isa_e lws_codec_init (void) {
+	lws_codec_isa_e  isa;
+
+	isa = LWS_CODEC_SCALAR;
+#if LWS_CODEC_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw")
+			&& __builtin_cpu_supports("popcnt")) {
+		isa = LWS_CODEC_AVX512;
+	} else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+		isa = LWS_CODEC_AVX2;
+	} else if (__builtin_cpu_supports("ssse3")) {
+		isa = LWS_CODEC_SSSE3;
+	}
+#endif
+	codec_kernel = &codec_kernels[isa];
+	return isa;
+}
+
+int lws_codec_set_isa (lws_codec_isa_e isa) {
+	if (isa > lws_codec_init()) {
+		return -1;
+	}
+	codec_kernel = &codec_kernels[isa];
+	return 0;
+}
+
+const char *lws_codec_isa_name (lws_codec_isa_e isa) {
+	return codec_kernel_names[isa];
+}
+
+
 int lws_base64_decode (uint8_t *in_out, size_t *in_out_len) {
-	size_t   len, in, out, blocks, i;
+	return lws_base64_decode_to(in_out, *in_out_len, in_out, in_out_len);
+}
+
+int lws_base64_decode_to (const uint8_t *src, size_t len, uint8_t *dst, size_t *dst_len) {
+	size_t   in, out, blocks, i;
 	uint8_t  a, b, c, d, va, vb, vc, vd;
 
-	len = *in_out_len;
+	/* dst may alias src as the output never overtakes the input */
 	if (len == 0) {
+		*dst_len = 0;
 		return 0;
 	}
 	if (len & 3) {
@@ -91,25 +704,27 @@ int lws_base64_decode (uint8_t *in_out, size_t *in_out_len) {
 	}
 	blocks = len / 4;
 
-	in = 0;
-	out = 0;
+	/* leading blocks, vectorized; the kernel stops short of invalid input */
+	in = codec_kernel->decode(src, len - 4, dst);
+	out = in / 4 * 3;
+	blocks -= in / 4;
 
-	/* leading blocks */
+	/* remaining leading blocks */
 	if (blocks > 1) {
 		for (i = 0; i < blocks - 1; i++) {
-			a  = in_out[in++]; b = in_out[in++]; c = in_out[in++]; d = in_out[in++];
+			a  = src[in++]; b = src[in++]; c = src[in++]; d = src[in++];
 			va = b64_dec_tbl[a]; vb = b64_dec_tbl[b]; vc = b64_dec_tbl[c]; vd = b64_dec_tbl[d];
 			if (__builtin_expect((va | vb | vc | vd) & 0x80, 0)) {
 				return -1;
 			}
-			in_out[out++] = (uint8_t)((va << 2) | (vb >> 4));
-			in_out[out++] = (uint8_t)((vb << 4) | (vc >> 2));
-			in_out[out++] = (uint8_t)((vc << 6) | vd);
+			dst[out++] = (uint8_t)((va << 2) | (vb >> 4));
+			dst[out++] = (uint8_t)((vb << 4) | (vc >> 2));
+			dst[out++] = (uint8_t)((vc << 6) | vd);
 		}
 	}
 
 	/* final block */
-	a  = in_out[in++]; b = in_out[in++]; c = in_out[in++]; d = in_out[in++];
+	a  = src[in++]; b = src[in++]; c = src[in++]; d = src[in++];
 	va = b64_dec_tbl[a]; vb = b64_dec_tbl[b];
 	if (__builtin_expect(va & 0x80 || vb & 0x80, 0)) {
 		return -1;
@@ -119,7 +734,7 @@ int lws_base64_decode (uint8_t *in_out, size_t *in_out_len) {
 		if (d != '=' || in != len) {
 			return -1;
 		}
-		in_out[out++] = (uint8_t)((va << 2) | (vb >> 4));
+		dst[out++] = (uint8_t)((va << 2) | (vb >> 4));
 	} else {
 		vc = b64_dec_tbl[c];
 		if (__builtin_expect(vc & 0x80, 0)) {
@@ -130,21 +745,21 @@ int lws_base64_decode (uint8_t *in_out, size_t *in_out_len) {
 			if (in != len) {
 				return -1;
 			}
-			in_out[out++] = (uint8_t)((va << 2) | (vb >> 4));
-			in_out[out++] = (uint8_t)((vb << 4) | (vc >> 2));
+			dst[out++] = (uint8_t)((va << 2) | (vb >> 4));
+			dst[out++] = (uint8_t)((vb << 4) | (vc >> 2));
 		} else {
 			vd = b64_dec_tbl[d];
 			if (__builtin_expect(vd & 0x80, 0)) {
 				return -1;
 			}
 			/* "xxxx" -> 3 bytes */
-			in_out[out++] = (uint8_t)((va << 2) | (vb >> 4));
-			in_out[out++] = (uint8_t)((vb << 4) | (vc >> 2));
-			in_out[out++] = (uint8_t)((vc << 6) | vd);
+			dst[out++] = (uint8_t)((va << 2) | (vb >> 4));
+			dst[out++] = (uint8_t)((vb << 4) | (vc >> 2));
+			dst[out++] = (uint8_t)((vc << 6) | vd);
 		}
 	}
 
-	*in_out_len = out;
+	*dst_len = out;
 	return 0;
 }
 
@@ -178,7 +793,10 @@ void lws_base64_encode (uint8_t *in_out, size_t *in_out_len) {
 		in_out[--i_out] = b64_enc_tbl[(v >> 10) & 0x3F];
 	}
 
-	/* process full 3-byte blocks */
+	/* process full 3-byte blocks, trailing blocks vectorized */
+	i_in  = codec_kernel->encode(in_out, i_in);
+	i_out = i_in / 3 * 4;
+	full  = i_in / 3;
 	while (full--) {
 		b2 = in_out[--i_in];
 		b1 = in_out[--i_in];
@@ -205,16 +823,277 @@ int lws_base64_encode_len (size_t in_len, size_t *out_len) {
 	return 0;
 }
 
-int lws_valid_utf8 (const uint8_t *p, size_t n) {
-	size_t    i;
-	uint32_t  state;
+void lws_base64_encode_to (const uint8_t *in, size_t in_len, uint8_t *out) {
+	size_t    full, rem, n;
+	uint32_t  v;
+
+	/* leading blocks, vectorized */
+	n = codec_kernel->encode_to(in, in_len, out);
+	in += n;
+	in_len -= n;
+	out += n / 3 * 4;
+
+	full = in_len / 3;
+	rem  = in_len % 3;
 
-	state = LWS_UTF8_ACCEPT;
+	/* process full 3-byte blocks */
+	while (full--) {
+		v = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+		out[0] = b64_enc_tbl[(v >> 18) & 0x3F];
+		out[1] = b64_enc_tbl[(v >> 12) & 0x3F];
+		out[2] = b64_enc_tbl[(v >> 6)  & 0x3F];
+		out[3] = b64_enc_tbl[ v        & 0x3F];
+		in += 3;
+		out += 4;
+	}
+
+	/* handle remainder */
+	if (rem == 1) {
+		out[0] = b64_enc_tbl[(in[0] >> 2) & 0x3F];
+		out[1] = b64_enc_tbl[(in[0] & 0x03) << 4];
+		out[2] = '=';
+		out[3] = '=';
+	} else if (rem == 2) {
+		v = ((uint32_t)in[0] << 8) | in[1];
+		out[0] = b64_enc_tbl[(v >> 10) & 0x3F];
+		out[1] = b64_enc_tbl[(v >> 4)  & 0x3F];
+		out[2] = b64_enc_tbl[(v << 2)  & 0x3F];
+		out[3] = '=';
+	}
+}
+
+int lws_json_escape_len (const uint8_t *p, size_t n, size_t *out_len) {
+	size_t  i, len;
+
+	if (n > SIZE_MAX / 6) {
+		return -1;
+	}
+	len = 0;
 	for (i = 0; i < n; i++) {
-		state = utf8d[256 + state + utf8d[p[i]]];
-		if (state == LWS_UTF8_REJECT) {
+		len += json_esc_tbl[p[i]];
+	}
+	*out_len = len;
+	return 0;
+}
+
+size_t lws_json_escape (const uint8_t *in, size_t *in_len, uint8_t *out, size_t out_len) {
+	size_t   i, n, o, k;
+	uint8_t  c;
+
+	n = *in_len;
+	o = 0;
+	for (i = 0; i < n; i++) {
+		/* copy the run needing no escape, vectorized */
+		k = n - i < out_len - o ? n - i : out_len - o;
+		k = codec_kernel->json_span(in + i, k);
+		memcpy(out + o, in + i, k);
+		i += k;
+		o += k;
+		if (i == n || o == out_len) {
+			break;
+		}
+
+		/* escape */
+		c = in[i];
+		k = json_esc_tbl[c];
+		if (out_len - o < k) {
+			break;
+		}
+		out[o++] = '\\';
+		switch (c) {
+		case '"':
+		case '\\':
+			out[o++] = c;
+			break;
+
+		case '\b':
+			out[o++] = 'b';
+			break;
+
+		case '\t':
+			out[o++] = 't';
+			break;
+
+		case '\n':
+			out[o++] = 'n';
+			break;
+
+		case '\f':
+			out[o++] = 'f';
+			break;
+
+		case '\r':
+			out[o++] = 'r';
+			break;
+
+		default:
+			out[o++] = 'u';
+			out[o++] = '0';
+			out[o++] = '0';
+			out[o++] = hex_tbl[c >> 4];
+			out[o++] = hex_tbl[c & 0x0F];
+		}
+	}
+	*in_len = i;
+	return o;
+}
+
+static int lws_json_hex4 (const uint8_t *p, uint32_t *cp) {
+	int      i;
+	uint8_t  c;
+
+	*cp = 0;
+	for (i = 0; i < 4; i++) {
+		c = p[i];
+		if (c >= '0' && c <= '9') {
+			c -= '0';
+		} else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+			c = (c | 0x20) - 'a' + 10;
+		} else {
+			return -1;
+		}
+		*cp = (*cp << 4) | c;
+	}
+	return 0;
+}
+
+int lws_json_unescape (const uint8_t *in, size_t in_len, uint8_t *out, size_t *out_len) {
+	size_t    i, o;
+	uint8_t   c;
+	uint32_t  cp, lo;
+
+	/* the output is never longer than the input; out may alias in */
+	o = 0;
+	for (i = 0; i < in_len; ) {
+		c = in[i++];
+		if (__builtin_expect(c != '\\', 1)) {
+			out[o++] = c;
+			continue;
+		}
+		if (i == in_len) {
+			return -1;
+		}
+		c = in[i++];
+		switch (c) {
+		case '"':
+		case '\\':
+		case '/':
+			out[o++] = c;
+			break;
+
+		case 'b':
+			out[o++] = '\b';
+			break;
+
+		case 't':
+			out[o++] = '\t';
+			break;
+
+		case 'n':
+			out[o++] = '\n';
+			break;
+
+		case 'f':
+			out[o++] = '\f';
+			break;
+
+		case 'r':
+			out[o++] = '\r';
+			break;
+
+		case 'u':
+			if (in_len - i < 4 || lws_json_hex4(in + i, &cp) != 0) {
+				return -1;
+			}
+			i += 4;
+			if (cp >= 0xD800 && cp <= 0xDBFF) {
+				/* surrogate pair */
+				if (in_len - i < 6 || in[i] != '\\' || in[i + 1] != 'u'
+						|| lws_json_hex4(in + i + 2, &lo) != 0
+						|| lo < 0xDC00 || lo > 0xDFFF) {
+					return -1;
+				}
+				i += 6;
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+			} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+				return -1;
+			}
+			if (cp < 0x80) {
+				out[o++] = (uint8_t)cp;
+			} else if (cp < 0x800) {
+				out[o++] = (uint8_t)(0xC0 | (cp >> 6));
+				out[o++] = (uint8_t)(0x80 | (cp & 0x3F));
+			} else if (cp < 0x10000) {
+				out[o++] = (uint8_t)(0xE0 | (cp >> 12));
+				out[o++] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+				out[o++] = (uint8_t)(0x80 | (cp & 0x3F));
+			} else {
+				out[o++] = (uint8_t)(0xF0 | (cp >> 18));
+				out[o++] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+				out[o++] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+				out[o++] = (uint8_t)(0x80 | (cp & 0x3F));
+			}
+			break;
+
+		default:
 			return -1;
 		}
 	}
-	return state == LWS_UTF8_ACCEPT ? 0 : -1;
+	*out_len = o;
+	return 0;
+}
+
+int lws_valid_utf8 (const uint8_t *p, size_t n) {
+	return lws_utf8_update(LWS_UTF8_ACCEPT, p, n) == LWS_UTF8_ACCEPT ? 0 : -1;
+}
+
+uint32_t lws_utf8_update (uint32_t state, const uint8_t *p, size_t n) {
+	size_t  i, len;
+
+	/* complete a pending sequence */
+	for (i = 0; i < n && state != LWS_UTF8_ACCEPT && state != LWS_UTF8_REJECT; i++) {
+		state = utf8d[256 + state + utf8d[p[i]]];
+	}
+
+	/* validate vectorized from a code point boundary */
+	if (state == LWS_UTF8_ACCEPT) {
+		if (codec_kernel->utf8(p + i, n - i, &len, NULL) != 0) {
+			return LWS_UTF8_REJECT;
+		}
+		i += len;
+	}
+
+	/* finish the tail */
+	for (; i < n && state != LWS_UTF8_REJECT; i++) {
+		state = utf8d[256 + state + utf8d[p[i]]];
+	}
+	return state;
+}
+
+uint32_t lws_utf8_escape_update (uint32_t state, const uint8_t *p, size_t n, size_t *esc_len) {
+	size_t  i, len, extra, sum;
+
+	/* complete a pending sequence */
+	sum = 0;
+	for (i = 0; i < n && state != LWS_UTF8_ACCEPT && state != LWS_UTF8_REJECT; i++) {
+		state = utf8d[256 + state + utf8d[p[i]]];
+		sum += json_esc_tbl[p[i]];
+	}
+
+	/* validate and sum the escaped length vectorized from a code point boundary */
+	if (state == LWS_UTF8_ACCEPT) {
+		if (codec_kernel->utf8(p + i, n - i, &len, &extra) != 0) {
+			return LWS_UTF8_REJECT;
+		}
+		i += len;
+		sum += len + extra;
+	}
+
+	/* finish the tail */
+	for (; i < n && state != LWS_UTF8_REJECT; i++) {
+		state = utf8d[256 + state + utf8d[p[i]]];
+		sum += json_esc_tbl[p[i]];
+	}
+	*esc_len += sum;
+	return state;
 }
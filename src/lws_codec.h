@@ -13,10 +13,40 @@
 #include <stdint.h>
 
 
+#define LWS_UTF8_ACCEPT  0
+#define LWS_UTF8_REJECT  12
+
+#ifndef LWS_CODEC_X86
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LWS_CODEC_X86  1
+#else
+#define LWS_CODEC_X86  0
+#endif
+#endif
+
+
+typedef enum {
+	LWS_CODEC_SCALAR,
+	LWS_CODEC_SSSE3,
+	LWS_CODEC_AVX2,
+	LWS_CODEC_AVX512
+} lws_codec_isa_e;
+
+
+lws_codec_isa_e lws_codec_init(void);
+int lws_codec_set_isa(lws_codec_isa_e isa);
+const char *lws_codec_isa_name(lws_codec_isa_e isa);
 int lws_base64_decode(uint8_t *in_out, size_t *in_out_len);
+int lws_base64_decode_to(const uint8_t *src, size_t len, uint8_t *dst, size_t *dst_len);
 void lws_base64_encode(uint8_t *in_out, size_t *in_out_len);
 int lws_base64_encode_len(size_t in_len, size_t *out_len);
+void lws_base64_encode_to(const uint8_t *in, size_t in_len, uint8_t *out);
+int lws_json_escape_len(const uint8_t *p, size_t n, size_t *out_len);
+size_t lws_json_escape(const uint8_t *in, size_t *in_len, uint8_t *out, size_t out_len);
+int lws_json_unescape(const uint8_t *in, size_t in_len, uint8_t *out, size_t *out_len);
 int lws_valid_utf8(const uint8_t *p, size_t n);
+uint32_t lws_utf8_update(uint32_t state, const uint8_t *p, size_t n);
+uint32_t lws_utf8_escape_update(uint32_t state, const uint8_t *p, size_t n, size_t *esc_len);
 
 
 #endif /* _LWS_CODEC_INCLUDED */
@@ -0,0 +1,698 @@
+/*
+ * LWS compression
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#include <limits.h>
+#include <lws_runtime.h>
+#include <lws_log.h>
+#include <lws_codec.h>
+#include <lws_compress.h>
+
+
+#define LWS_COMPRESS_OUT_MIN    1024  /* minimum output space per round */
+#define LWS_DECOMPRESS_OUT_MIN  4096  /* initial decompression output capacity */
+
+
+static int lws_compress_qvalue(char **p, char *end);
+static int lws_compress_reserve(lws_compress_t *c, size_t len, size_t n);
+static int lws_compress_header(lws_ctx_t *ctx, lws_str_t *key, lws_str_t *prefix,
+		lws_str_t *value);
+static int lws_compress_vary(lws_ctx_t *ctx);
+static int lws_decompress_encoding(lws_str_t *content_encoding);
+static int lws_decompress_grow(lws_str_t *out, size_t *cap, size_t max);
+
+
+lws_str_t lws_content_encodings[] = {
+	lws_string("identity"),
+	lws_string("deflate"),
+	lws_string("gzip"),
+	lws_string("zstd")
+};
+
+
+/*
+ * negotiation
+ */
+
+static int lws_compress_qvalue (char **p, char *end) {
+	int  q, scale;
+
+	/* qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] ) */
+	if (*p == end || (**p != '0' && **p != '1')) {
+		return -1;
+	}
+	q = (**p - '0') * 1000;
+	(*p)++;
+	if (*p < end && **p == '.') {
+		(*p)++;
+		scale = 100;
+		while (*p < end && **p >= '0' && **p <= '9') {
+			q += (**p - '0') * scale;
+			scale /= 10;
+			(*p)++;
+		}
+	}
+	return q <= 1000 ? q : 1000;
+}
+
+lws_content_encoding_e lws_compress_negotiate (lws_str_t *accept_encoding) {
+	int                     q, qs[LWS_CE_ZSTD + 1], wildcard, best_q;
+	char                   *p, *end, *token;
+	size_t                  len, i;
+	lws_content_encoding_e  e, best, prefs[] = { LWS_CE_ZSTD, LWS_CE_GZIP, LWS_CE_DEFLATE };
+
+	/* collect the qvalues of the codings; unlisted codings take the wildcard qvalue */
+	for (e = LWS_CE_IDENTITY; e <= LWS_CE_ZSTD; e++) {
+		qs[e] = -1;
+	}
+	wildcard = 0;
+	p = accept_encoding->data;
+	end = p + accept_encoding->len;
+	while (p < end) {
+		/* coding */
+		while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) {
+			p++;
+		}
+		token = p;
+		while (p < end && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') {
+			p++;
+		}
+		len = p - token;
+
+		/* parameters */
+		q = 1000;
+		while (p < end && *p != ',') {
+			if (*p == ';') {
+				p++;
+				while (p < end && (*p == ' ' || *p == '\t')) {
+					p++;
+				}
+				if (end - p >= 2 && (*p == 'q' || *p == 'Q') && p[1] == '=') {
+					p += 2;
+					if ((q = lws_compress_qvalue(&p, end)) < 0) {
+						q = 0;  /* malformed; not acceptable */
+					}
+					continue;
+				}
+			}
+			p++;
+		}
+
+		/* assign */
+		if (len == 1 && token[0] == '*') {
+			wildcard = q;
+		} else if ((len == 4 && lws_strncasecmp(token, "gzip", 4) == 0)
+				|| (len == 6 && lws_strncasecmp(token, "x-gzip", 6) == 0)) {
+			qs[LWS_CE_GZIP] = q;
+		} else if (len == 7 && lws_strncasecmp(token, "deflate", 7) == 0) {
+			qs[LWS_CE_DEFLATE] = q;
+		} else if (len == 4 && lws_strncasecmp(token, "zstd", 4) == 0) {
+			qs[LWS_CE_ZSTD] = q;
+		}
+	}
+
+	/* highest qvalue; ties go to the preferred coding */
+	best = LWS_CE_IDENTITY;
+	best_q = 0;
+	for (i = 0; i < sizeof(prefs) / sizeof(prefs[0]); i++) {
+		e = prefs[i];
+		if (e == LWS_CE_ZSTD && !LWS_ZSTD) {
+			continue;
+		}
+		q = qs[e] >= 0 ? qs[e] : wildcard;
+		if (q > best_q) {
+			best = e;
+			best_q = q;
+		}
+	}
+	return best;
+}
+
+int lws_compress_type_allowed (lws_str_t *types, lws_str_t *content_type) {
+	char    *p, *end, *entry;
+	size_t   len, n;
+
+	/* media type without parameters */
+	len = 0;
+	while (len < content_type->len && content_type->data[len] != ';'
+			&& content_type->data[len] != ' ') {
+		len++;
+	}
+
+	/* match the comma-separated entries; a wildcard subtype matches all subtypes */
+	p = types->data;
+	end = p + types->len;
+	while (p < end) {
+		while (p < end && (*p == ' ' || *p == ',')) {
+			p++;
+		}
+		entry = p;
+		while (p < end && *p != ',' && *p != ' ') {
+			p++;
+		}
+		n = p - entry;
+		if (n == 0) {
+			continue;
+		}
+		if ((n == 1 && entry[0] == '*') || (n == 3 && lws_strncmp(entry, "*/*", 3) == 0)) {
+			return 1;
+		}
+		if (n >= 2 && entry[n - 2] == '/' && entry[n - 1] == '*') {
+			if (len > n - 1 && lws_strncasecmp(content_type->data, entry, n - 1) == 0) {
+				return 1;
+			}
+		} else if (len == n && lws_strncasecmp(content_type->data, entry, n) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * compressor
+ */
+
+static int lws_compress_reserve (lws_compress_t *c, size_t len, size_t n) {
+	char    *out;
+	size_t   cap;
+
+	if (c->cap - len >= n) {
+		return 0;
+	}
+	if (n > SIZE_MAX - len) {
+		return -1;
+	}
+	cap = c->cap <= SIZE_MAX / 2 ? c->cap * 2 : SIZE_MAX;
+	if (cap < len + n) {
+		cap = len + n;
+	}
+	out = lws_realloc(c->out, cap);
+	if (!out) {
+		return -1;
+	}
+	c->out = out;
+	c->cap = cap;
+	return 0;
+}
+
+lws_compress_t *lws_compress_create (lws_content_encoding_e encoding, int level) {
+	lws_compress_t  *c;
+
+	c = lws_calloc(sizeof(lws_compress_t));
+	if (!c) {
+		return NULL;
+	}
+	c->encoding = encoding;
+	switch (encoding) {
+	case LWS_CE_DEFLATE:
+	case LWS_CE_GZIP:
+		if (deflateInit2(&c->z, level ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+				encoding == LWS_CE_GZIP ? MAX_WBITS + 16 : MAX_WBITS, 8,
+				Z_DEFAULT_STRATEGY) != Z_OK) {
+			lws_log(LWS_LOG_ERR, "failed to initialize zlib stream");
+			lws_free(c);
+			return NULL;
+		}
+		break;
+
+#if LWS_ZSTD
+	case LWS_CE_ZSTD:
+		c->zstd = ZSTD_createCCtx();
+		if (!c->zstd) {
+			lws_log(LWS_LOG_ERR, "failed to create zstd context");
+			lws_free(c);
+			return NULL;
+		}
+		if (level && ZSTD_isError(ZSTD_CCtx_setParameter(c->zstd, ZSTD_c_compressionLevel,
+				level))) {
+			lws_log(LWS_LOG_ERR, "failed to set zstd compression level");
+			ZSTD_freeCCtx(c->zstd);
+			lws_free(c);
+			return NULL;
+		}
+		break;
+#endif
+
+	default:
+		lws_log(LWS_LOG_ERR, "bad content encoding:%d", encoding);
+		lws_free(c);
+		return NULL;
+	}
+	return c;
+}
+
+void lws_compress_free (lws_compress_t *c) {
+	switch (c->encoding) {
+	case LWS_CE_DEFLATE:
+	case LWS_CE_GZIP:
+		deflateEnd(&c->z);
+		break;
+
+#if LWS_ZSTD
+	case LWS_CE_ZSTD:
+		ZSTD_freeCCtx(c->zstd);
+		break;
+#endif
+
+	default:
+		break;
+	}
+	if (c->out) {
+		lws_free(c->out);
+	}
+	lws_free(c);
+}
+
+int lws_compress_update (lws_compress_t *c, const char *in, size_t in_len, int finish,
+		lws_str_t *out) {
+	int              rc;
+	size_t           len, avail;
+#if LWS_ZSTD
+	size_t           remaining;
+	ZSTD_inBuffer    zin;
+	ZSTD_outBuffer   zout;
+#endif
+
+	/* compress and flush; the output is valid until the next call */
+	len = 0;
+	switch (c->encoding) {
+	case LWS_CE_DEFLATE:
+	case LWS_CE_GZIP:
+		if (in_len > UINT_MAX) {
+			lws_log(LWS_LOG_ERR, "compression input too large len:%zu", in_len);
+			return -1;
+		}
+		c->z.next_in = (Bytef *)in;
+		c->z.avail_in = (uInt)in_len;
+		do {
+			if (lws_compress_reserve(c, len, c->z.avail_in / 2 + LWS_COMPRESS_OUT_MIN) != 0) {
+				goto oom;
+			}
+			avail = c->cap - len;
+			if (avail > UINT_MAX) {
+				avail = UINT_MAX;
+			}
+			c->z.next_out = (Bytef *)c->out + len;
+			c->z.avail_out = (uInt)avail;
+			rc = deflate(&c->z, finish ? Z_FINISH : Z_SYNC_FLUSH);
+			if (rc == Z_STREAM_ERROR) {
+				lws_log(LWS_LOG_ERR, "failed to compress");
+				return -1;
+			}  /* Z_BUF_ERROR means no progress was possible */
+			len += avail - c->z.avail_out;
+		} while (c->z.avail_out == 0 || (finish && rc != Z_STREAM_END));
+		break;
+
+#if LWS_ZSTD
+	case LWS_CE_ZSTD:
+		zin.src = in;
+		zin.size = in_len;
+		zin.pos = 0;
+		do {
+			if (lws_compress_reserve(c, len, ZSTD_CStreamOutSize()) != 0) {
+				goto oom;
+			}
+			zout.dst = c->out + len;
+			zout.size = c->cap - len;
+			zout.pos = 0;
+			remaining = ZSTD_compressStream2(c->zstd, &zout, &zin, finish ? ZSTD_e_end
+					: ZSTD_e_flush);
+			if (ZSTD_isError(remaining)) {
+				lws_log(LWS_LOG_ERR, "failed to compress: %s", ZSTD_getErrorName(remaining));
+				return -1;
+			}
+			len += zout.pos;
+		} while (remaining != 0);
+		break;
+#endif
+
+	default:
+		return -1;
+	}
+
+	out->data = c->out;
+	out->len = len;
+	return 0;
+
+	oom:
+	lws_log(LWS_LOG_CRIT, "out of memory");
+	return -1;
+}
+
+
+/*
+ * response
+ */
+
+static int lws_compress_header (lws_ctx_t *ctx, lws_str_t *key, lws_str_t *prefix,
+		lws_str_t *value) {
+	size_t      len;
+	lws_str_t  *dup;
+
+	/* value, or prefix and value as a list */
+	len = value->len + (prefix ? prefix->len + 2 : 0);
+	dup = lws_arena_alloc(ctx->arena, sizeof(lws_str_t) + len);
+	if (!dup) {
+		return -1;
+	}
+	dup->data = (char *)dup + sizeof(lws_str_t);
+	dup->len = 0;
+	if (prefix) {
+		memcpy(dup->data, prefix->data, prefix->len);
+		memcpy(dup->data + prefix->len, ", ", 2);
+		dup->len = prefix->len + 2;
+	}
+	memcpy(dup->data + dup->len, value->data, value->len);
+	dup->len += value->len;
+	if (lws_table_set(ctx->resp_headers, key, dup) != 0) {
+		return -1;
+	}
+	return 0;
+}
+
+static int lws_compress_vary (lws_ctx_t *ctx) {
+	size_t      i;
+	lws_str_t   key, *vary, ae;
+
+	lws_str_set(&key, "Vary");
+	lws_str_set(&ae, "Accept-Encoding");
+	vary = lws_table_get(ctx->resp_headers, &key);
+	if (vary) {
+		for (i = 0; i < vary->len; i++) {
+			if (vary->data[i] == '*' || (vary->len - i >= ae.len
+					&& lws_strncasecmp(vary->data + i, ae.data, ae.len) == 0)) {
+				return 0;
+			}
+		}
+	}
+	return lws_compress_header(ctx, &key, vary, &ae);
+}
+
+int lws_compress_prepare (lws_ctx_t *ctx, int streaming) {
+	lws_str_t               key, *value;
+	lws_content_encoding_e  encoding;
+
+	/* eligible? buffered responses must reach the minimum size */
+	if (!ctx->compress || ctx->compressor || ctx->raw) {
+		return 0;
+	}
+	if (!streaming && (ctx->resp_body.len == 0 || ctx->resp_body.len < ctx->compress_min)) {
+		return 0;
+	}
+	lws_str_set(&key, "Content-Encoding");
+	if (lws_table_get(ctx->resp_headers, &key)) {
+		return 0;  /* encoded by the Lua chunks */
+	}
+	lws_str_set(&key, "Content-Type");
+	value = lws_table_get(ctx->resp_headers, &key);
+	if (!value || !lws_compress_type_allowed(&ctx->compress_types, value)) {
+		return 0;
+	}
+
+	/* the response varies with the accepted encodings */
+	if (lws_compress_vary(ctx) != 0) {
+		goto oom;
+	}
+
+	/* negotiate */
+	lws_str_set(&key, "Accept-Encoding");
+	value = lws_table_get(ctx->req_headers, &key);
+	encoding = value ? lws_compress_negotiate(value) : LWS_CE_IDENTITY;
+	if (encoding == LWS_CE_IDENTITY) {
+		return 0;
+	}
+
+	/* compressor; the length changes */
+	ctx->compressor = lws_compress_create(encoding, (int)ctx->compress_level);
+	if (!ctx->compressor) {
+		return -1;
+	}
+	lws_str_set(&key, "Content-Encoding");
+	if (lws_compress_header(ctx, &key, NULL, &lws_content_encodings[encoding]) != 0) {
+		goto oom;
+	}
+	lws_str_set(&key, "Content-Length");
+	lws_table_set(ctx->resp_headers, &key, NULL);
+	lws_log_debug("compress encoding:%.*s streaming:%d",
+			(int)lws_content_encodings[encoding].len, lws_content_encodings[encoding].data,
+			streaming);
+	return 0;
+
+	oom:
+	lws_log(LWS_LOG_CRIT, "out of memory");
+	return -1;
+}
+
+int lws_compress_body (lws_ctx_t *ctx, int finish) {
+	lws_str_t        out;
+	lws_compress_t  *c;
+
+	/* compress the response body, or the data written since the last flush */
+	c = ctx->compressor;
+	if (!c) {
+		return 0;
+	}
+	if (lws_compress_update(c, ctx->resp_body.data, ctx->resp_body.len, finish, &out) != 0) {
+		return -1;
+	}
+
+	/* replace the body; it stays in its region, and the output buffer is reused */
+	if (lws_region_commit(&ctx->resp_region, out.len) != 0) {
+		return -1;
+	}
+	memcpy(ctx->resp_body.data, out.data, out.len);
+	ctx->resp_body.len = out.len;
+	ctx->resp_body_pos = 0;
+	ctx->resp_body_utf8 = LWS_UTF8_ACCEPT;
+	ctx->resp_body_utf8_pos = 0;
+	ctx->resp_body_escaped = 0;
+	return 0;
+}
+
+
+/*
+ * request
+ */
+
+static int lws_decompress_encoding (lws_str_t *content_encoding) {
+	char    *p, *end;
+	size_t   len;
+
+	/* a single coding; stacked codings are left to the Lua chunks */
+	p = content_encoding->data;
+	end = p + content_encoding->len;
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	while (end > p && (end[-1] == ' ' || end[-1] == '\t')) {
+		end--;
+	}
+	len = end - p;
+	if ((len == 4 && lws_strncasecmp(p, "gzip", 4) == 0)
+			|| (len == 6 && lws_strncasecmp(p, "x-gzip", 6) == 0)) {
+		return LWS_CE_GZIP;
+	}
+	if (len == 7 && lws_strncasecmp(p, "deflate", 7) == 0) {
+		return LWS_CE_DEFLATE;
+	}
+	if (LWS_ZSTD && len == 4 && lws_strncasecmp(p, "zstd", 4) == 0) {
+		return LWS_CE_ZSTD;
+	}
+	return -1;
+}
+
+static int lws_decompress_grow (lws_str_t *out, size_t *cap, size_t max) {
+	char    *data;
+	size_t   new_cap;
+
+	/* reserves space for a terminating NUL beyond max */
+	if (out->len >= max) {
+		lws_log(LWS_LOG_ERR, "request body decompression limit exceeded max:%zu", max);
+		return -1;
+	}
+	new_cap = *cap <= SIZE_MAX / 2 ? *cap * 2 : SIZE_MAX;
+	if (new_cap < LWS_DECOMPRESS_OUT_MIN) {
+		new_cap = LWS_DECOMPRESS_OUT_MIN;
+	}
+	if (new_cap > max) {
+		new_cap = max + 1;
+	}
+	data = lws_realloc(out->data, new_cap);
+	if (!data) {
+		lws_log(LWS_LOG_CRIT, "out of memory");
+		return -1;
+	}
+	out->data = data;
+	*cap = new_cap;
+	return 0;
+}
+
+int lws_decompress (lws_content_encoding_e encoding, lws_str_t *in, size_t max,
+		lws_str_t *out) {
+	int              rc;
+	size_t           cap, avail;
+	z_stream         z;
+#if LWS_ZSTD
+	size_t           hint;
+	ZSTD_DCtx       *zstd;
+	ZSTD_inBuffer    zin;
+	ZSTD_outBuffer   zout;
+#endif
+
+	/* init state; the output is NUL-terminated and owned by the caller */
+	rc = -1;
+	lws_str_null(out);
+	cap = 0;
+	if (max == SIZE_MAX) {
+		max--;
+	}
+
+	switch (encoding) {
+	case LWS_CE_DEFLATE:
+	case LWS_CE_GZIP:
+		if (in->len > UINT_MAX) {
+			lws_log(LWS_LOG_ERR, "decompression input too large len:%zu", in->len);
+			return -1;
+		}
+		memset(&z, 0, sizeof(z));
+		if (inflateInit2(&z, encoding == LWS_CE_GZIP ? MAX_WBITS + 16 : MAX_WBITS) != Z_OK) {
+			lws_log(LWS_LOG_ERR, "failed to initialize zlib stream");
+			return -1;
+		}
+		z.next_in = (Bytef *)in->data;
+		z.avail_in = (uInt)in->len;
+		do {
+			if (cap - out->len <= 1 && lws_decompress_grow(out, &cap, max) != 0) {
+				inflateEnd(&z);
+				goto error;
+			}
+			avail = cap - 1 - out->len;
+			if (avail > UINT_MAX) {
+				avail = UINT_MAX;
+			}
+			z.next_out = (Bytef *)out->data + out->len;
+			z.avail_out = (uInt)avail;
+			rc = inflate(&z, Z_NO_FLUSH);
+			out->len += avail - z.avail_out;
+			if (rc == Z_STREAM_END && z.avail_in > 0 && encoding == LWS_CE_GZIP) {
+				rc = inflateReset(&z);  /* concatenated gzip members */
+			}
+		} while (rc == Z_OK || (rc == Z_BUF_ERROR && z.avail_out == 0));
+		inflateEnd(&z);
+		if (rc != Z_STREAM_END) {
+			lws_log(LWS_LOG_ERR, "failed to decompress request body rc:%d", rc);
+			goto error;
+		}
+		break;
+
+#if LWS_ZSTD
+	case LWS_CE_ZSTD:
+		zstd = ZSTD_createDCtx();
+		if (!zstd) {
+			lws_log(LWS_LOG_ERR, "failed to create zstd context");
+			return -1;
+		}
+		zin.src = in->data;
+		zin.size = in->len;
+		zin.pos = 0;
+		do {
+			if (cap - out->len <= 1 && lws_decompress_grow(out, &cap, max) != 0) {
+				ZSTD_freeDCtx(zstd);
+				goto error;
+			}
+			zout.dst = out->data + out->len;
+			zout.size = cap - 1 - out->len;
+			zout.pos = 0;
+			hint = ZSTD_decompressStream(zstd, &zout, &zin);
+			out->len += zout.pos;
+			if (ZSTD_isError(hint)) {
+				lws_log(LWS_LOG_ERR, "failed to decompress request body: %s",
+						ZSTD_getErrorName(hint));
+				ZSTD_freeDCtx(zstd);
+				goto error;
+			}
+		} while (hint != 0 && (zin.pos < zin.size || zout.pos == zout.size));
+		ZSTD_freeDCtx(zstd);
+		if (hint != 0) {
+			lws_log(LWS_LOG_ERR, "truncated zstd request body");
+			goto error;
+		}
+		break;
+#endif
+
+	default:
+		lws_log(LWS_LOG_ERR, "bad content encoding:%d", encoding);
+		return -1;
+	}
+
+	/* terminate */
+	if (!out->data && lws_decompress_grow(out, &cap, max) != 0) {
+		goto error;
+	}
+	out->data[out->len] = '\0';
+	return 0;
+
+	error:
+	if (out->data) {
+		lws_free(out->data);
+		lws_str_null(out);
+	}
+	return -1;
+}
+
+void lws_decompress_prepare (lws_ctx_t *ctx) {
+	int         encoding;
+	lws_str_t   key, *value;
+
+	/* note a supported encoding; the body is decompressed on first access */
+	if (!ctx->decompress) {
+		return;
+	}
+	lws_str_set(&key, "Content-Encoding");
+	value = lws_table_get(ctx->req_headers, &key);
+	if (!value) {
+		return;
+	}
+	encoding = lws_decompress_encoding(value);
+	if (encoding < 0) {
+		lws_log_debug("request encoding not decompressed:%.*s", (int)value->len, value->data);
+		return;
+	}
+	ctx->req_body_encoding = encoding;
+	ctx->req_body_pos = 0;
+}
+
+int lws_decompress_request (lws_ctx_t *ctx) {
+	size_t      max;
+	lws_str_t   out;
+
+	/* decompress once; the decompressed body replaces the view of the encoded body */
+	if (ctx->req_body_encoding == LWS_CE_IDENTITY) {
+		return 0;
+	}
+	if (ctx->req_body_failed) {
+		return -1;
+	}
+	if (ctx->req_body.len == 0) {
+		ctx->req_body_encoding = LWS_CE_IDENTITY;
+		return 0;
+	}
+	max = ctx->req_body.len <= SIZE_MAX / (size_t)ctx->decompress
+			? ctx->req_body.len * (size_t)ctx->decompress : SIZE_MAX;
+	if (lws_decompress(ctx->req_body_encoding, &ctx->req_body, max, &out) != 0) {
+		ctx->req_body_failed = 1;
+		return -1;
+	}
+	lws_log_debug("request decompressed len:%zu decompressed:%zu", ctx->req_body.len, out.len);
+	if (ctx->req_body_decoded) {
+		lws_free(ctx->req_body.data);
+	}
+	ctx->req_body = out;
+	ctx->req_body_decoded = 1;
+	ctx->req_body_encoding = LWS_CE_IDENTITY;
+	return 0;
+}
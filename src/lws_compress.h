@@ -0,0 +1,67 @@
+/*
+ * LWS compression
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#ifndef _LWS_COMPRESS_INCLUDED
+#define _LWS_COMPRESS_INCLUDED
+
+
+#ifndef LWS_ZSTD
+#define LWS_ZSTD  0
+#endif
+
+
+#include <zlib.h>
+#if LWS_ZSTD
+#include <zstd.h>
+#endif
+
+
+#define LWS_COMPRESS_TYPES_DEFAULT  "text/*,application/json,application/javascript," \
+		"application/xml,image/svg+xml"
+
+
+typedef struct lws_compress_s lws_compress_t;
+
+typedef enum {
+	LWS_CE_IDENTITY,
+	LWS_CE_DEFLATE,
+	LWS_CE_GZIP,
+	LWS_CE_ZSTD
+} lws_content_encoding_e;
+
+
+#include <lws_runtime.h>
+
+
+struct lws_compress_s {
+	lws_content_encoding_e   encoding;  /* content encoding */
+	z_stream                 z;         /* zlib stream; deflate, gzip */
+#if LWS_ZSTD
+	ZSTD_CCtx               *zstd;      /* zstd context */
+#endif
+	char                    *out;       /* output buffer */
+	size_t                   cap;       /* output buffer capacity */
+};
+
+
+extern lws_str_t lws_content_encodings[];
+
+
+lws_content_encoding_e lws_compress_negotiate(lws_str_t *accept_encoding);
+int lws_compress_type_allowed(lws_str_t *types, lws_str_t *content_type);
+lws_compress_t *lws_compress_create(lws_content_encoding_e encoding, int level);
+void lws_compress_free(lws_compress_t *c);
+int lws_compress_update(lws_compress_t *c, const char *in, size_t in_len, int finish,
+		lws_str_t *out);
+int lws_compress_prepare(lws_ctx_t *ctx, int streaming);
+int lws_compress_body(lws_ctx_t *ctx, int finish);
+int lws_decompress(lws_content_encoding_e encoding, lws_str_t *in, size_t max, lws_str_t *out);
+void lws_decompress_prepare(lws_ctx_t *ctx);
+int lws_decompress_request(lws_ctx_t *ctx);
+
+
+#endif /* _LWS_COMPRESS_INCLUDED */
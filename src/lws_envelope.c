@@ -0,0 +1,599 @@
+/*
+ * LWS payload envelope
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#include <string.h>
+#include <lws_runtime.h>
+#include <lws_log.h>
+#include <lws_codec.h>
+#include <lws_compress.h>
+#include <lws_envelope.h>
+
+
+#define lws_scan_is(key, lit)  ((key)->len == sizeof(lit) - 1  \
+		&& lws_strncmp((key)->data, lit, sizeof(lit) - 1) == 0)
+
+
+typedef struct lws_scan_s lws_scan_t;
+
+struct lws_scan_s {
+	char  *p;    /* position */
+	char  *end;  /* end of input */
+};
+
+
+/* scanner */
+static void lws_scan_ws(lws_scan_t *s);
+static int lws_scan_char(lws_scan_t *s, char c);
+static int lws_scan_next(lws_scan_t *s, char close, size_t *n);
+static int lws_scan_string(lws_scan_t *s, lws_str_t *span, int *escaped);
+static int lws_scan_bool(lws_scan_t *s, int *value);
+static int lws_scan_skip(lws_scan_t *s);
+
+/* envelope */
+static int lws_envelope_string(lws_ctx_t *ctx, lws_scan_t *s, lws_str_t *value);
+static int lws_envelope_http(lws_ctx_t *ctx, lws_scan_t *s);
+static int lws_envelope_request_context(lws_ctx_t *ctx, lws_scan_t *s);
+static int lws_envelope_headers(lws_ctx_t *ctx, lws_scan_t *s);
+static int lws_envelope_cookies(lws_ctx_t *ctx, lws_scan_t *s);
+static int lws_envelope_decode(lws_ctx_t *ctx);
+
+
+/*
+ * scanner
+ */
+
+static void lws_scan_ws (lws_scan_t *s) {
+	while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r')) {
+		s->p++;
+	}
+}
+
+static int lws_scan_char (lws_scan_t *s, char c) {
+	lws_scan_ws(s);
+	if (s->p == s->end || *s->p != c) {
+		return -1;
+	}
+	s->p++;
+	return 0;
+}
+
+static int lws_scan_next (lws_scan_t *s, char close, size_t *n) {
+	/* 1 if another element follows, 0 at the end of the container, -1 if malformed */
+	lws_scan_ws(s);
+	if (s->p == s->end) {
+		return -1;
+	}
+	if (*s->p == close) {
+		s->p++;
+		return 0;
+	}
+	if (*n > 0) {
+		if (*s->p != ',') {
+			return -1;
+		}
+		s->p++;
+	}
+	(*n)++;
+	return 1;
+}
+
+static int lws_scan_string (lws_scan_t *s, lws_str_t *span, int *escaped) {
+	char    *start, *q;
+	size_t   k;
+
+	/* raw span between the quotes; a quote preceded by an odd number of backslashes is escaped */
+	lws_scan_ws(s);
+	if (s->p == s->end || *s->p != '"') {
+		return -1;
+	}
+	start = ++s->p;
+	q = start;
+	for (;;) {
+		q = memchr(q, '"', s->end - q);
+		if (!q) {
+			return -1;
+		}
+		k = 0;
+		while (q - k > start && q[-(ptrdiff_t)k - 1] == '\\') {
+			k++;
+		}
+		if (!(k & 1)) {
+			break;
+		}
+		q++;
+	}
+	span->data = start;
+	span->len = q - start;
+	*escaped = memchr(start, '\\', span->len) != NULL;
+	s->p = q + 1;
+	return 0;
+}
+
+static int lws_scan_bool (lws_scan_t *s, int *value) {
+	lws_scan_ws(s);
+	if (s->end - s->p >= 4 && lws_strncmp(s->p, "true", 4) == 0) {
+		s->p += 4;
+		*value = 1;
+		return 0;
+	}
+	if (s->end - s->p >= 5 && lws_strncmp(s->p, "false", 5) == 0) {
+		s->p += 5;
+		*value = 0;
+		return 0;
+	}
+	return -1;
+}
+
+static int lws_scan_skip (lws_scan_t *s) {
+	int         escaped;
+	char       *start;
+	size_t      depth;
+	lws_str_t   span;
+
+	/* skips a value, checking the nesting of containers but not their contents */
+	lws_scan_ws(s);
+	if (s->p == s->end) {
+		return -1;
+	}
+	switch (*s->p) {
+	case '"':
+		return lws_scan_string(s, &span, &escaped);
+
+	case '{':
+	case '[':
+		depth = 0;
+		do {
+			switch (*s->p) {
+			case '"':
+				if (lws_scan_string(s, &span, &escaped) != 0) {
+					return -1;
+				}
+				continue;
+
+			case '{':
+			case '[':
+				depth++;
+				break;
+
+			case '}':
+			case ']':
+				depth--;
+				break;
+			}
+			s->p++;
+		} while (depth > 0 && s->p < s->end);
+		return depth == 0 ? 0 : -1;
+
+	default:
+		/* number or literal */
+		start = s->p;
+		while (s->p < s->end && *s->p != ',' && *s->p != '}' && *s->p != ']'
+				&& *s->p != ' ' && *s->p != '\t' && *s->p != '\n' && *s->p != '\r') {
+			s->p++;
+		}
+		return s->p > start ? 0 : -1;
+	}
+}
+
+
+/*
+ * envelope
+ */
+
+static int lws_envelope_string (lws_ctx_t *ctx, lws_scan_t *s, lws_str_t *value) {
+	int         escaped;
+	lws_str_t   span;
+
+	/* strings without escapes are referenced in place */
+	if (lws_scan_string(s, &span, &escaped) != 0) {
+		return -1;
+	}
+	if (!escaped) {
+		*value = span;
+		return 0;
+	}
+	value->data = lws_arena_alloc(ctx->arena, span.len + 1);
+	if (!value->data) {
+		return -1;
+	}
+	if (lws_json_unescape((uint8_t *)span.data, span.len, (uint8_t *)value->data,
+			&value->len) != 0) {
+		return -1;
+	}
+	value->data[value->len] = '\0';
+	return 0;
+}
+
+static int lws_envelope_http (lws_ctx_t *ctx, lws_scan_t *s) {
+	int         rc, escaped;
+	size_t      n;
+	lws_str_t   key;
+
+	if (lws_scan_char(s, '{') != 0) {
+		lws_log(LWS_LOG_ERR, "http not an object");
+		return -1;
+	}
+	n = 0;
+	while ((rc = lws_scan_next(s, '}', &n)) > 0) {
+		if (lws_scan_string(s, &key, &escaped) != 0 || lws_scan_char(s, ':') != 0) {
+			return -1;
+		}
+		if (lws_scan_is(&key, "method")) {
+			if (lws_envelope_string(ctx, s, &ctx->req_method) != 0) {
+				lws_log(LWS_LOG_ERR, "method not a string");
+				return -1;
+			}
+		} else if (lws_scan_is(&key, "sourceIp")) {
+			if (lws_envelope_string(ctx, s, &ctx->req_ip) != 0) {
+				lws_log(LWS_LOG_ERR, "sourceIp not a string");
+				return -1;
+			}
+		} else if (lws_scan_skip(s) != 0) {
+			return -1;
+		}
+	}
+	return rc;
+}
+
+static int lws_envelope_request_context (lws_ctx_t *ctx, lws_scan_t *s) {
+	int         rc, escaped;
+	size_t      n;
+	lws_str_t   key;
+
+	if (lws_scan_char(s, '{') != 0) {
+		lws_log(LWS_LOG_ERR, "requestContext not an object");
+		return -1;
+	}
+	n = 0;
+	while ((rc = lws_scan_next(s, '}', &n)) > 0) {
+		if (lws_scan_string(s, &key, &escaped) != 0 || lws_scan_char(s, ':') != 0) {
+			return -1;
+		}
+		if (lws_scan_is(&key, "http")) {
+			if (lws_envelope_http(ctx, s) != 0) {
+				return -1;
+			}
+		} else if (lws_scan_skip(s) != 0) {
+			return -1;
+		}
+	}
+	return rc;
+}
+
+static int lws_envelope_headers (lws_ctx_t *ctx, lws_scan_t *s) {
+	int         rc, escaped;
+	size_t      n;
+	lws_str_t   key, span, *value;
+
+	if (lws_scan_char(s, '{') != 0) {
+		lws_log(LWS_LOG_ERR, "headers not an object");
+		return -1;
+	}
+	n = 0;
+	while ((rc = lws_scan_next(s, '}', &n)) > 0) {
+		if (lws_envelope_string(ctx, s, &key) != 0 || lws_scan_char(s, ':') != 0
+				|| lws_scan_string(s, &span, &escaped) != 0) {
+			lws_log(LWS_LOG_ERR, "header key or value not a string");
+			return -1;
+		}
+		if (escaped) {
+			value = lws_arena_alloc(ctx->arena, sizeof(lws_str_t) + span.len);
+			if (!value) {
+				return -1;
+			}
+			value->data = (char *)value + sizeof(lws_str_t);
+			if (lws_json_unescape((uint8_t *)span.data, span.len, (uint8_t *)value->data,
+					&value->len) != 0) {
+				lws_log(LWS_LOG_ERR, "bad header value escape");
+				return -1;
+			}
+		} else {
+			value = lws_arena_alloc(ctx->arena, sizeof(lws_str_t));
+			if (!value) {
+				return -1;
+			}
+			*value = span;
+		}
+		if (lws_table_set(ctx->req_headers, &key, value) != 0) {
+			return -1;
+		}
+	}
+	return rc;
+}
+
+static int lws_envelope_cookies (lws_ctx_t *ctx, lws_scan_t *s) {
+	int           rc, escaped;
+	char         *start, *p;
+	size_t        n, len, total_len;
+	lws_str_t     key, span, *value;
+	lws_uint_t    count;
+
+	/* size the header from the raw lengths, which bound the unescaped lengths */
+	start = s->p;
+	if (lws_scan_char(s, '[') != 0) {
+		lws_log(LWS_LOG_ERR, "cookies not an array");
+		return -1;
+	}
+	total_len = 0;
+	count = 0;
+	n = 0;
+	while ((rc = lws_scan_next(s, ']', &n)) > 0) {
+		if (lws_scan_string(s, &span, &escaped) != 0) {
+			lws_log(LWS_LOG_ERR, "cookie value not a string");
+			return -1;
+		}
+		if (span.len == 0) {
+			continue;
+		}
+		if (span.len > SIZE_MAX - sizeof(lws_str_t) - 2
+				|| total_len > SIZE_MAX - sizeof(lws_str_t) - 2 - span.len) {
+			lws_log(LWS_LOG_ERR, "cookies header too large");
+			return -1;
+		}
+		total_len += span.len + (count ? 2 : 0);
+		count++;
+	}
+	if (rc < 0) {
+		return -1;
+	}
+	if (!count) {
+		return 0;
+	}
+
+	/* join */
+	value = lws_arena_alloc(ctx->arena, sizeof(lws_str_t) + total_len);
+	if (!value) {
+		return -1;
+	}
+	value->data = (char *)value + sizeof(lws_str_t);
+	p = value->data;
+	s->p = start + 1;
+	count = 0;
+	n = 0;
+	while (lws_scan_next(s, ']', &n) > 0) {
+		(void)lws_scan_string(s, &span, &escaped);  /* checked above */
+		if (span.len == 0) {
+			continue;
+		}
+		if (count) {
+			memcpy(p, ", ", 2);
+			p += 2;
+		}
+		if (escaped) {
+			if (lws_json_unescape((uint8_t *)span.data, span.len, (uint8_t *)p, &len) != 0) {
+				lws_log(LWS_LOG_ERR, "bad cookie value escape");
+				return -1;
+			}
+			p += len;
+		} else {
+			memcpy(p, span.data, span.len);
+			p += span.len;
+		}
+		count++;
+	}
+	value->len = p - value->data;
+	lws_str_set(&key, "Cookie");
+	if (lws_table_set(ctx->req_headers, &key, value) != 0) {
+		return -1;
+	}
+	return 0;
+}
+
+int lws_envelope_scan (lws_ctx_t *ctx) {
+	int          rc, escaped, body, base64;
+	char        *cookies;
+	size_t       n;
+	lws_str_t    key, version;
+	lws_scan_t   s;
+
+	/* init state */
+	s.p = ctx->body.data;
+	s.end = s.p + ctx->body.len;
+	lws_str_null(&version);
+	cookies = NULL;
+	body = 0;
+	base64 = -1;
+
+	/* root; the known fields in one pass, with the body recorded as a raw span */
+	if (lws_scan_char(&s, '{') != 0) {
+		goto malformed;
+	}
+	n = 0;
+	while ((rc = lws_scan_next(&s, '}', &n)) > 0) {
+		if (lws_scan_string(&s, &key, &escaped) != 0 || lws_scan_char(&s, ':') != 0) {
+			goto malformed;
+		}
+		if (lws_scan_is(&key, "version")) {
+			if (lws_envelope_string(ctx, &s, &version) != 0) {
+				lws_log(LWS_LOG_ERR, "version not a string");
+				return -1;
+			}
+		} else if (lws_scan_is(&key, "rawPath")) {
+			if (lws_envelope_string(ctx, &s, &ctx->req_path) != 0) {
+				lws_log(LWS_LOG_ERR, "rawPath not a string");
+				return -1;
+			}
+		} else if (lws_scan_is(&key, "rawQueryString")) {
+			if (lws_envelope_string(ctx, &s, &ctx->req_args) != 0) {
+				lws_log(LWS_LOG_ERR, "rawQueryString not a string");
+				return -1;
+			}
+		} else if (lws_scan_is(&key, "requestContext")) {
+			if (lws_envelope_request_context(ctx, &s) != 0) {
+				goto malformed;
+			}
+		} else if (lws_scan_is(&key, "headers")) {
+			if (lws_envelope_headers(ctx, &s) != 0) {
+				goto malformed;
+			}
+		} else if (lws_scan_is(&key, "cookies")) {
+			lws_scan_ws(&s);
+			cookies = s.p;  /* joined after the headers */
+			if (lws_scan_skip(&s) != 0) {
+				goto malformed;
+			}
+		} else if (lws_scan_is(&key, "body")) {
+			if (lws_scan_string(&s, &ctx->req_body, &escaped) != 0) {
+				lws_log(LWS_LOG_ERR, "request body not a string");
+				return -1;
+			}
+			ctx->req_body_escaped = escaped;
+			body = 1;
+		} else if (lws_scan_is(&key, "isBase64Encoded")) {
+			if (lws_scan_bool(&s, &base64) != 0) {
+				lws_log(LWS_LOG_ERR, "isBase64Encoded not a boolean");
+				return -1;
+			}
+		} else if (lws_scan_skip(&s) != 0) {
+			goto malformed;
+		}
+	}
+	if (rc < 0) {
+		goto malformed;
+	}
+
+	/* version */
+	if (!version.data) {
+		lws_log(LWS_LOG_ERR, "version not found in root");
+		return -1;
+	}
+	if (!lws_scan_is(&version, LWS_LAMBDA_PAYLOAD_VERSION)) {
+		lws_log(LWS_LOG_ERR, "unsupported payload version:%.*s", (int)version.len, version.data);
+		return -1;
+	}
+
+	/* path, method, and args */
+	if (!ctx->req_path.data) {
+		lws_log(LWS_LOG_ERR, "rawPath not found");
+		return -1;
+	}
+	if (!ctx->req_method.data) {
+		lws_log(LWS_LOG_ERR, "method not found");
+		return -1;
+	}
+	if (!ctx->req_args.data) {
+		lws_str_set(&ctx->req_args, "");
+	}
+
+	/* cookies */
+	if (cookies) {
+		s.p = cookies;
+		if (lws_envelope_cookies(ctx, &s) != 0) {
+			return -1;
+		}
+	}
+
+	/* request body; decoded on first access */
+	if (body) {
+		if (base64 < 0) {
+			lws_log(LWS_LOG_ERR, "isBase64Encoded not found");
+			return -1;
+		}
+		ctx->req_body_base64 = base64;
+	} else {
+		lws_str_set(&ctx->req_body, "");
+	}
+
+	return 0;
+
+	malformed:
+	lws_log(LWS_LOG_ERR, "malformed request envelope offset:%td", s.p - ctx->body.data);
+	return -1;
+}
+
+
+/*
+ * request body
+ */
+
+static int lws_envelope_decode (lws_ctx_t *ctx) {
+	char    *data;
+	size_t   len;
+
+	/* unescape and base64-decode into an owned copy, leaving the envelope intact */
+	if (!ctx->req_body_escaped && !ctx->req_body_base64) {
+		return 0;
+	}
+	len = ctx->req_body.len;
+	data = lws_alloc((ctx->req_body_escaped ? len : len / 4 * 3) + 1);
+	if (!data) {
+		goto error;
+	}
+	if (ctx->req_body_escaped) {
+		if (lws_json_unescape((uint8_t *)ctx->req_body.data, ctx->req_body.len, (uint8_t *)data,
+				&len) != 0) {
+			lws_log(LWS_LOG_ERR, "failed to unescape request body");
+			goto error;
+		}
+		if (ctx->req_body_base64 && lws_base64_decode((uint8_t *)data, &len) != 0) {
+			lws_log(LWS_LOG_ERR, "failed to decode base64 request body");
+			goto error;
+		}
+	} else {
+		/* base64 decodes straight from the envelope */
+		if (lws_base64_decode_to((uint8_t *)ctx->req_body.data, ctx->req_body.len,
+				(uint8_t *)data, &len) != 0) {
+			lws_log(LWS_LOG_ERR, "failed to decode base64 request body");
+			goto error;
+		}
+	}
+	data[len] = '\0';
+	ctx->req_body.data = data;
+	ctx->req_body.len = len;
+	ctx->req_body_decoded = 1;
+	ctx->req_body_escaped = 0;
+	ctx->req_body_base64 = 0;
+	return 0;
+
+	error:
+	if (data) {
+		lws_free(data);
+	}
+	ctx->req_body_failed = 1;
+	return -1;
+}
+
+int lws_envelope_body (lws_ctx_t *ctx) {
+	if (ctx->req_body_failed) {
+		return -1;
+	}
+	if (lws_envelope_decode(ctx) != 0) {
+		return -1;
+	}
+	return lws_decompress_request(ctx);
+}
+
+yyjson_doc *lws_envelope_doc (lws_ctx_t *ctx) {
+	yyjson_val  *val;
+
+	/* parse in place on first access */
+	if (ctx->doc) {
+		return ctx->doc;
+	}
+	ctx->doc = yyjson_read_opts(ctx->body.data, ctx->body.len, YYJSON_READ_INSITU, &ctx->doc_alc,
+			NULL);
+	if (!ctx->doc) {
+		lws_log(LWS_LOG_ERR, "failed to parse request body as JSON");
+		if (ctx->req_body_escaped) {
+			ctx->req_body_failed = 1;  /* may have been unescaped in part */
+		}
+		return NULL;
+	}
+
+	/* the parse unescapes a pending body in place; continue from the parsed string */
+	if (ctx->req_body_escaped) {
+		val = yyjson_obj_get(yyjson_doc_get_root(ctx->doc), "body");
+		if (val && yyjson_is_str(val)) {
+			ctx->req_body.data = (char *)yyjson_get_str(val);
+			ctx->req_body.len = yyjson_get_len(val);
+			ctx->req_body_escaped = 0;
+		} else {
+			ctx->req_body_failed = 1;
+		}
+	}
+	return ctx->doc;
+}
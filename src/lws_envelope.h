@@ -0,0 +1,23 @@
+/*
+ * LWS payload envelope
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#ifndef _LWS_ENVELOPE_INCLUDED
+#define _LWS_ENVELOPE_INCLUDED
+
+
+#include <lws_runtime.h>
+
+
+#define LWS_LAMBDA_PAYLOAD_VERSION  "2.0"
+
+
+int lws_envelope_scan(lws_ctx_t *ctx);
+int lws_envelope_body(lws_ctx_t *ctx);
+yyjson_doc *lws_envelope_doc(lws_ctx_t *ctx);
+
+
+#endif /* _LWS_ENVELOPE_INCLUDED */
@@ -7,17 +7,17 @@
 
 #include <errno.h>
 #include <pthread.h>
-#include <signal.h>
-#include <unistd.h>
+#include <time.h>
 #include <lws_runtime.h>
 #include <lws_log.h>
 #include <lws_interface.h>
 #include <lws_ngx.h>
 #include <lws_codec.h>
+#include <lws_compress.h>
+#include <lws_envelope.h>
 #include <curl/curl.h>
 
 
-#define LWS_USERAGENT               "lambda-lws/0.9"
 #define LWS_CURL_OFF_T_MAX          (size_t)((curl_off_t)(~(curl_off_t)0 >> 1))
 #define LWS_CONTENT_LENGTH          "Content-Length"
 #define LWS_LAMBDA_TRACE_ID         "Lambda-Runtime-Trace-Id"
@@ -25,50 +25,132 @@
 #define LWS_LAMBDA_STREAMING_CT     "Content-Type: application/vnd.awslambda.http-integration-response"
 #define LWS_LAMBDA_STREAMING_MODE   "Lambda-Runtime-Function-Response-Mode: streaming"
 #define LWS_LAMBDA_TRACE_ID_ENV     "_X_AMZN_TRACE_ID"
-#define LWS_LAMBDA_RUNTIME_VERSION  "2018-06-01"
-#define LWS_LAMBDA_PAYLOAD_VERSION  "2.0"
 #define LWS_LAMBDA_SEPARATOR_LEN    8
 #define LWS_CURL_INITIATE           1
 #define LWS_CURL_FINALIZE           2
+#define LWS_CURL_POLL               4
+#define LWS_JSON_CT                 "Content-Type: application/json"
+#define LWS_ENVELOPE_BODY           ",\"body\":\""
+#define LWS_ENVELOPE_TEXT           "\",\"isBase64Encoded\":false}"
+#define LWS_ENVELOPE_BASE64         "\",\"isBase64Encoded\":true}"
+#define LWS_UPLOAD_BODY             "{\"body\":\""
+#define LWS_UPLOAD_TAIL             ",\"isBase64Encoded\":false}"
+#define LWS_SSE_CT                  "text/event-stream"
+#define LWS_SSE_HEARTBEAT           ":\n"  /* comment line */
+
+typedef struct lws_stream_chunk_s lws_stream_chunk_t;
+
+struct lws_stream_chunk_s {
+	lws_stream_chunk_t  *next;    /* next chunk */
+	size_t               len;     /* length */
+	size_t               pos;     /* send position */
+	char                 data[];  /* data */
+};
+
+/* while running, the sender thread owns the runtime API client and the streaming state */
+struct lws_sender_s {
+	pthread_t            thread;     /* sender thread */
+	pthread_mutex_t      mutex;      /* queue mutex */
+	pthread_cond_t       cond;       /* queue changed */
+	lws_stream_chunk_t  *head;       /* first queued chunk */
+	lws_stream_chunk_t  *tail;       /* last queued chunk */
+	size_t               queued;     /* queued bytes */
+	size_t               max;        /* queued bytes bound */
+	lws_stream_chunk_t  *chunk;      /* chunk being sent */
+	unsigned             done:1;     /* end of stream being sent; sender thread only */
+	unsigned             lf:1;       /* sent data ends with a line feed; sender thread only */
+	lws_int_t            heartbeat;  /* SSE heartbeat interval [ms]; 0 = off */
+	lws_stream_chunk_t  *ping;       /* SSE heartbeat chunk */
+	struct timespec      ping_at;    /* next SSE heartbeat */
+	unsigned             eof:1;      /* no further chunks; guarded by the mutex */
+	unsigned             stop:1;     /* drop the stream; guarded by the mutex */
+	unsigned             failed:1;   /* request failed; guarded by the mutex */
+};
+
 
 /* libcurl */
-static void lws_curl_reset(lws_ctx_t *ctx);
+static void lws_curl_reset(CURL *curl);
+static void lws_curl_next(lws_ctx_t *ctx, CURL *curl);
+static int lws_curl_result(CURL *curl, CURLcode result);
 static int lws_curl_perform(lws_ctx_t *ctx, int flags);
-static int lws_handle_socket(void *userdata, curl_socket_t fd, curlsocktype purpose);
+static int lws_curl_overlap(lws_ctx_t *ctx);
+static int lws_curl_finalize_next(lws_ctx_t *ctx);
 static size_t lws_handle_header(char *buffer, size_t size, size_t nitems, void *userdata);
 static size_t lws_handle_write(char *ptr, size_t size, size_t nmemb, void *userdata);
+static size_t lws_read_prelude(lws_ctx_t *ctx, char *ptr, size_t len);
 static size_t lws_handle_read(char *ptr, size_t size, size_t nmemb, void *userdata);
+static size_t lws_handle_queue(char *ptr, size_t size, size_t nmemb, void *userdata);
+static size_t lws_handle_envelope(char *ptr, size_t size, size_t nmemb, void *userdata);
+static int lws_handle_seek(void *userdata, curl_off_t offset, int origin);
+static size_t lws_handle_upload(char *ptr, size_t size, size_t nmemb, void *userdata);
 
 /* runtime interface */
 static int lws_add_cookie(yyjson_mut_doc *doc, yyjson_mut_val *arr, char *data, size_t start,
 		size_t end);
 static int lws_add_headers(lws_ctx_t *ctx, yyjson_mut_doc *doc);
-
-
-static volatile sig_atomic_t cancel_poll = 0;
-static volatile sig_atomic_t in_poll = 0;
-static volatile curl_socket_t curl_socket = CURL_SOCKET_BAD;
+static int lws_prepare_envelope(lws_ctx_t *ctx, yyjson_mut_doc *doc, int base64);
+static int lws_finish_upload(lws_ctx_t *ctx);
+static int lws_stream_begin(lws_ctx_t *ctx, lws_client_read_pt read);
+static void lws_compact_stream(lws_ctx_t *ctx);
+static int lws_stream_resume(lws_ctx_t *ctx, lws_client_read_pt read, int finish);
+static void lws_schedule_ping(lws_sender_t *s);
+static void *lws_send_stream(void *userdata);
+static int lws_enqueue_stream(lws_ctx_t *ctx, const char *data, size_t len, int finish);
+static int lws_queue_stream(lws_ctx_t *ctx, int finish);
+static int lws_start_sender(lws_ctx_t *ctx);
+static int lws_join_sender(lws_ctx_t *ctx);
 
 
 /*
  * libcurl
  */
 
-static void lws_curl_reset (lws_ctx_t *ctx) {
-	curl_easy_reset(ctx->curl);
-	curl_easy_setopt(ctx->curl, CURLOPT_NOSIGNAL, 1L);
-	curl_easy_setopt(ctx->curl, CURLOPT_CONNECTTIMEOUT, 1L);
-	curl_easy_setopt(ctx->curl, CURLOPT_TIMEOUT, 0L);
-	curl_easy_setopt(ctx->curl, CURLOPT_TCP_NODELAY, 1L);
-	curl_easy_setopt(ctx->curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
-	curl_easy_setopt(ctx->curl, CURLOPT_USERAGENT, LWS_USERAGENT);
+static void lws_curl_reset (CURL *curl) {
+	curl_easy_reset(curl);
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 1L);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L);
+	curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+	curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+	curl_easy_setopt(curl, CURLOPT_USERAGENT, LWS_USERAGENT);
+}
+
+static void lws_curl_next (lws_ctx_t *ctx, CURL *curl) {
+	char  invocation_url[256];
+
+	snprintf(invocation_url, sizeof(invocation_url), "http://%.*s/%s/runtime/invocation/next",
+			(int)ctx->runtime_api.len, ctx->runtime_api.data, LWS_LAMBDA_RUNTIME_VERSION);
+	lws_curl_reset(curl);
+	curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+	curl_easy_setopt(curl, CURLOPT_URL, invocation_url);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, lws_handle_header);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, ctx);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, lws_handle_write);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, ctx);
+}
+
+static int lws_curl_result (CURL *curl, CURLcode result) {
+	long  code;
+
+	if (result != CURLE_OK) {
+		lws_log(LWS_LOG_CRIT, "libcurl easy error code:%d str:%s", result,
+				curl_easy_strerror(result));
+		return -1;
+	}
+	if (curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code) != CURLE_OK) {
+		lws_log(LWS_LOG_CRIT, "failed to get HTTP status code");
+		return -1;
+	}
+	if (code < 200 || code >= 300) {
+		lws_log(LWS_LOG_CRIT, "bad HTTP status code:%ld", code);
+		return -1;
+	}
+	return 0;
 }
 
 static int lws_curl_perform (lws_ctx_t *ctx, int flags) {
-	int        remain, rc;
-	long       code;
-	CURLMsg   *msg;
-	CURLMcode  mres;
+	int       remain, rc;
+	CURLMsg  *msg;
 
 	/* add the handle */
 	if (flags & LWS_CURL_INITIATE) {
@@ -78,20 +160,23 @@ static int lws_curl_perform (lws_ctx_t *ctx, int flags) {
 		}
 	}
 
-	/* drive the request */
+	/* drive the request; a just added transfer is counted as running once the loop has run */
 	while (1) {
-		mres = curl_multi_perform(ctx->curlm, &remain);
-		if (mres != CURLM_OK) {
-			lws_log(LWS_LOG_CRIT, "libcurl multi error code:%d str:%s", mres,
-					curl_multi_strerror(mres));	
-			return -1;
+		if (!(flags & LWS_CURL_INITIATE)) {
+			if (!(flags & LWS_CURL_FINALIZE) && (ctx->streaming_paused || !ctx->loop->running)) {
+				return 0;  /* not supposed to finalize and done for now */
+			} else if (!ctx->loop->running) {
+				break;  /* request complete */
+			}
 		}
-		if (!(flags & LWS_CURL_FINALIZE) && (ctx->streaming_paused || !remain)) {
-			return 0;  /* not supposed to finalize and done for now */
-		} else if (!remain) {
-			break;  /* request complete */
+		if ((rc = lws_loop_wait(ctx->loop, flags & LWS_CURL_POLL)) != 0) {
+			if (rc == LWS_LOOP_STOPPED) {
+				lws_log(LWS_LOG_NOTICE, "poll cancelled");
+			}
+			rc = -1;
+			goto cleanup;
 		}
-		curl_multi_wait(ctx->curlm, NULL, 0, 1000, NULL);
+		flags &= ~LWS_CURL_INITIATE;
 	}
 
 	/* reap the result */
@@ -105,21 +190,7 @@ static int lws_curl_perform (lws_ctx_t *ctx, int flags) {
 		if (msg->msg != CURLMSG_DONE) {
 			continue;
 		}
-		if (msg->data.result != CURLE_OK) {
-			if (cancel_poll) {
-				lws_log(LWS_LOG_NOTICE, "poll cancelled");
-			} else {
-				lws_log(LWS_LOG_CRIT, "libcurl easy error code:%d str:%s",
-						msg->data.result, curl_easy_strerror(msg->data.result));
-			}
-			goto cleanup;
-		}
-		if (curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &code) != CURLE_OK) {
-			lws_log(LWS_LOG_CRIT, "failed to get HTTP status code");
-			goto cleanup;
-		}
-		if (code < 200 || code >= 300) {
-			lws_log(LWS_LOG_CRIT, "bad HTTP status code:%ld", code);
+		if (lws_curl_result(msg->easy_handle, msg->data.result) != 0) {
 			goto cleanup;
 		}
 		break;
@@ -137,16 +208,95 @@ static int lws_curl_perform (lws_ctx_t *ctx, int flags) {
 	return rc;
 }
 
-static int lws_handle_socket (void *userdata, curl_socket_t fd, curlsocktype purpose) {
-	if (purpose != CURLSOCKTYPE_IPCXN) {
-		return 0;
+static int lws_curl_overlap (lws_ctx_t *ctx) {
+	int       remain, rc;
+	CURLMsg  *msg;
+
+	/* add the response handle unless uploading, then the held next invocation handle */
+	if (!ctx->uploading && curl_multi_add_handle(ctx->curlm, ctx->curl) != CURLM_OK) {
+		lws_log(LWS_LOG_CRIT, "failed to add libcurl easy handle to multi handle");
+		return -1;
 	}
-	if (cancel_poll) {
-		return -1;  /* prevent reconnect attempt after forcefully closing socket */
+	if (!ctx->next_pending) {
+		lws_curl_next(ctx, ctx->curl_next);
+		ctx->next_hold = 1;
+		if (curl_multi_add_handle(ctx->curlm, ctx->curl_next) == CURLM_OK) {
+			ctx->next_pending = 1;
+		} else {
+			lws_log_debug("failed to add next invocation handle");
+		}
 	}
-	curl_socket = fd;  /* get hold of socket to forcefully close to cancel poll */
-	lws_log_debug("captured socket fd:%d", fd);
-	return 0;
+
+	/* drive both requests until the response request completes */
+	rc = -1;
+	while (1) {
+		while ((msg = curl_multi_info_read(ctx->curlm, &remain))) {
+			if (msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+			if (msg->easy_handle == ctx->curl) {
+				rc = lws_curl_result(ctx->curl, msg->data.result);
+				goto cleanup;
+			}
+			lws_log_debug("early next invocation request failed code:%d", msg->data.result);
+			curl_multi_remove_handle(ctx->curlm, ctx->curl_next);
+			ctx->next_pending = 0;
+		}
+		if (lws_loop_wait(ctx->loop, 0) != 0) {
+			goto cleanup;
+		}
+	}
+
+	cleanup:
+	if (curl_multi_remove_handle(ctx->curlm, ctx->curl) != CURLM_OK) {
+		lws_log(LWS_LOG_CRIT, "failed to remove libcurl easy handle from multi handle");
+		rc = -1;
+	}
+	if (rc != 0 && ctx->next_pending) {
+		curl_multi_remove_handle(ctx->curlm, ctx->curl_next);
+		ctx->next_pending = 0;
+	}
+
+	return rc;
+}
+
+static int lws_curl_finalize_next (lws_ctx_t *ctx) {
+	int       remain, rc;
+	CURLMsg  *msg;
+
+	/* release held data */
+	ctx->next_hold = 0;
+	ctx->next_pending = 0;
+	rc = -1;
+	if (curl_easy_pause(ctx->curl_next, CURLPAUSE_CONT) != CURLE_OK) {
+		lws_log(LWS_LOG_CRIT, "failed to resume next invocation request");
+		goto cleanup;
+	}
+
+	/* drive the request */
+	while (1) {
+		while ((msg = curl_multi_info_read(ctx->curlm, &remain))) {
+			if (msg->msg == CURLMSG_DONE && msg->easy_handle == ctx->curl_next) {
+				rc = lws_curl_result(ctx->curl_next, msg->data.result);
+				goto cleanup;
+			}
+		}
+		if ((rc = lws_loop_wait(ctx->loop, 1)) != 0) {
+			if (rc == LWS_LOOP_STOPPED) {
+				lws_log(LWS_LOG_NOTICE, "poll cancelled");
+			}
+			rc = -1;
+			goto cleanup;
+		}
+	}
+
+	cleanup:
+	if (curl_multi_remove_handle(ctx->curlm, ctx->curl_next) != CURLM_OK) {
+		lws_log(LWS_LOG_CRIT, "failed to remove libcurl easy handle from multi handle");
+		return -1;
+	}
+
+	return rc;
 }
 
 static size_t lws_handle_header (char *buffer, size_t size, size_t nitems, void *userdata) {
@@ -155,8 +305,13 @@ static size_t lws_handle_header (char *buffer, size_t size, size_t nitems, void
 	lws_ctx_t     *ctx;
 	lws_str_t      key, *value, *value_new;
 
-	/* sanity checks */
+	/* hold overlapped next invocation */
 	ctx = userdata;
+	if (ctx->next_hold) {
+		return CURL_WRITEFUNC_PAUSE;
+	}
+
+	/* sanity checks */
 	if (nitems && size > SIZE_MAX / nitems) {
 		lws_log(LWS_LOG_ERR, "header size overflow size:%zu nitems:%zu", size, nitems);
 		return 0;
@@ -182,7 +337,8 @@ static size_t lws_handle_header (char *buffer, size_t size, size_t nitems, void
 			key.data = buffer;
 			value = lws_table_get(ctx->headers, &key);
 			if (!value) {
-				value = lws_alloc(sizeof(lws_str_t) + val_len + 1);
+				/* the key follows the value, as the table references it */
+				value = lws_arena_alloc(ctx->arena, sizeof(lws_str_t) + val_len + 1 + name_len);
 				if (!value) {
 					return 0;
 				}
@@ -190,9 +346,14 @@ static size_t lws_handle_header (char *buffer, size_t size, size_t nitems, void
 				value->data = (char *)(value + 1);
 				memcpy(value->data, val, val_len);
 				value->data[val_len] = '\0';
-				lws_table_set(ctx->headers, &key, value);
+				key.data = value->data + val_len + 1;
+				memcpy(key.data, buffer, name_len);
+				if (lws_table_set(ctx->headers, &key, value) != 0) {
+					return 0;
+				}
 			} else {
-				value_new = lws_alloc(sizeof(lws_str_t) + value->len + 2 + val_len + 1);
+				value_new = lws_arena_alloc(ctx->arena, sizeof(lws_str_t) + value->len + 2 + val_len
+						+ 1);
 				if (!value_new) {
 					return 0;
 				}
@@ -215,8 +376,13 @@ static size_t lws_handle_write (char *ptr, size_t size, size_t nmemb, void *user
 	size_t      len, required, capacity;
 	lws_ctx_t  *ctx;
 
-	/* sanity checks */
+	/* hold overlapped next invocation */
 	ctx = userdata;
+	if (ctx->next_hold) {
+		return CURL_WRITEFUNC_PAUSE;
+	}
+
+	/* sanity checks */
 	if (nmemb && size > SIZE_MAX / nmemb) {
 		lws_log(LWS_LOG_ERR, "request body size overflow size:%zu nmemb:%zu", size, nmemb);
 		return 0;
@@ -229,8 +395,7 @@ static size_t lws_handle_write (char *ptr, size_t size, size_t nmemb, void *user
 
 	/* determine required space */
 	required = ctx->body.len + len + YYJSON_PADDING_SIZE;
-	if (ctx->body_cap == 0 && ctx->content_length >= 0 && required < (size_t)ctx->content_length
-			+ YYJSON_PADDING_SIZE) {
+	if (ctx->content_length >= 0 && required < (size_t)ctx->content_length + YYJSON_PADDING_SIZE) {
 		/* use content length hint */
 		required = (size_t)ctx->content_length + YYJSON_PADDING_SIZE;
 	}
@@ -271,20 +436,11 @@ static size_t lws_handle_write (char *ptr, size_t size, size_t nmemb, void *user
 	return len;
 }
 
-static size_t lws_handle_read (char *ptr, size_t size, size_t nmemb, void *userdata) {
-	size_t      len, remain, n;
-	lws_ctx_t  *ctx;
-
-	/* sanity checks */
-	ctx = userdata;
-	if (nmemb && size > SIZE_MAX / nmemb) {
-		lws_log(LWS_LOG_ERR, "request body size overflow size:%zu nmemb:%zu", size, nmemb);
-		return CURL_READFUNC_ABORT;
-	}
-	len = size * nmemb;
-	remain = len;
+static size_t lws_read_prelude (lws_ctx_t *ctx, char *ptr, size_t len) {
+	size_t  remain, n;
 
 	/* send prelude */
+	remain = len;
 	if (ctx->streaming_prelude_pos < ctx->streaming_prelude.len) {
 		n = ctx->streaming_prelude.len - ctx->streaming_prelude_pos;
 		if (n > remain) {
@@ -305,9 +461,28 @@ static size_t lws_handle_read (char *ptr, size_t size, size_t nmemb, void *userd
 		lws_memzero(ptr, n);
 		ctx->streaming_separator += n;
 		remain -= n;
-		ptr += n;
 	}
 
+	return len - remain;
+}
+
+static size_t lws_handle_read (char *ptr, size_t size, size_t nmemb, void *userdata) {
+	size_t      len, remain, n;
+	lws_ctx_t  *ctx;
+
+	/* sanity checks */
+	ctx = userdata;
+	if (nmemb && size > SIZE_MAX / nmemb) {
+		lws_log(LWS_LOG_ERR, "request body size overflow size:%zu nmemb:%zu", size, nmemb);
+		return CURL_READFUNC_ABORT;
+	}
+	len = size * nmemb;
+
+	/* send prelude and separator */
+	n = lws_read_prelude(ctx, ptr, len);
+	remain = len - n;
+	ptr += n;
+
 	/* send response data, end, or pause streaming */
 	if (ctx->resp_body_pos < ctx->resp_body.len) {
 		n = ctx->resp_body.len - ctx->resp_body_pos;
@@ -320,6 +495,36 @@ static size_t lws_handle_read (char *ptr, size_t size, size_t nmemb, void *userd
 		ptr += n;
 	}
 
+	/* send produced data, pulling at most once per call */
+	if (ctx->producer && remain == len) {
+		if (ctx->produced_pos == ctx->produced.len) {
+			ctx->produced_pos = 0;
+			switch (ctx->producer(ctx->producer_data, &ctx->produced)) {
+			case 0:
+				if (ctx->compressor && lws_compress_update(ctx->compressor,
+						ctx->produced.data, ctx->produced.len, 0, &ctx->produced) != 0) {
+					return CURL_READFUNC_ABORT;
+				}
+				break;
+
+			case 1:
+				ctx->producer = NULL;  /* end of data; pause below */
+				lws_str_null(&ctx->produced);
+				break;
+
+			default:
+				return CURL_READFUNC_ABORT;
+			}
+		}
+		n = ctx->produced.len - ctx->produced_pos;
+		if (n > remain) {
+			n = remain;
+		}
+		memcpy(ptr, ctx->produced.data + ctx->produced_pos, n);
+		ctx->produced_pos += n;
+		remain -= n;
+	}
+
 	/* nothing sent? */
 	if (remain == len) {
 		if (ctx->streaming_eof) {
@@ -333,38 +538,163 @@ static size_t lws_handle_read (char *ptr, size_t size, size_t nmemb, void *userd
 	return len - remain;
 }
 
+static size_t lws_handle_queue (char *ptr, size_t size, size_t nmemb, void *userdata) {
+	size_t               len, remain, n;
+	lws_ctx_t           *ctx;
+	lws_stream_chunk_t  *chunk;
+
+	/* sanity checks */
+	ctx = userdata;
+	if (nmemb && size > SIZE_MAX / nmemb) {
+		lws_log(LWS_LOG_ERR, "request body size overflow size:%zu nmemb:%zu", size, nmemb);
+		return CURL_READFUNC_ABORT;
+	}
+	len = size * nmemb;
+
+	/* send prelude and separator */
+	n = lws_read_prelude(ctx, ptr, len);
+	remain = len - n;
+	ptr += n;
+
+	/* send the current chunk of the sender thread */
+	chunk = ctx->sender->chunk;
+	if (chunk && chunk->pos < chunk->len) {
+		n = chunk->len - chunk->pos;
+		if (n > remain) {
+			n = remain;
+		}
+		memcpy(ptr, chunk->data + chunk->pos, n);
+		chunk->pos += n;
+		remain -= n;
+	}
+
+	/* nothing sent? pause until the next chunk, unless the stream is done */
+	if (remain == len) {
+		if (ctx->sender->done) {
+			return 0;  /* end of data */
+		}
+		ctx->streaming_paused = 1;
+		return CURL_READFUNC_PAUSE;  /* chunk sent, or none yet */
+	}
+
+	return len - remain;
+}
+
+static size_t lws_handle_envelope (char *ptr, size_t size, size_t nmemb, void *userdata) {
+	size_t      len, remain, n, in_len;
+	uint8_t    *out, *in;
+	lws_ctx_t  *ctx;
+	lws_str_t  *suffix;
+
+	/* sanity checks */
+	ctx = userdata;
+	if (nmemb && size > SIZE_MAX / nmemb) {
+		lws_log(LWS_LOG_ERR, "request body size overflow size:%zu nmemb:%zu", size, nmemb);
+		return CURL_READFUNC_ABORT;
+	}
+	len = size * nmemb;
+	remain = len;
+	out = (uint8_t *)ptr;
+
+	/* send envelope prefix */
+	if (ctx->envelope_pos < ctx->envelope.len) {
+		n = ctx->envelope.len - ctx->envelope_pos;
+		if (n > remain) {
+			n = remain;
+		}
+		memcpy(out, ctx->envelope.data + ctx->envelope_pos, n);
+		ctx->envelope_pos += n;
+		remain -= n;
+		out += n;
+	}
+
+	/* send response body, encoded chunk by chunk */
+	if (ctx->envelope_pos == ctx->envelope.len && ctx->resp_body_pos < ctx->resp_body.len) {
+		in = (uint8_t *)ctx->resp_body.data + ctx->resp_body_pos;
+		in_len = ctx->resp_body.len - ctx->resp_body_pos;
+		if (ctx->envelope_base64) {
+			if (in_len > remain / 4 * 3) {
+				in_len = remain / 4 * 3;  /* whole blocks only */
+			}
+			lws_base64_encode_to(in, in_len, out);
+			n = (in_len + 2) / 3 * 4;
+		} else {
+			n = lws_json_escape(in, &in_len, out, remain);
+		}
+		ctx->resp_body_pos += in_len;
+		remain -= n;
+		out += n;
+	}
+
+	/* send envelope suffix */
+	suffix = &ctx->envelope_suffix;
+	if (ctx->envelope_pos == ctx->envelope.len && ctx->resp_body_pos == ctx->resp_body.len
+			&& ctx->envelope_suffix_pos < suffix->len) {
+		n = suffix->len - ctx->envelope_suffix_pos;
+		if (n > remain) {
+			n = remain;
+		}
+		memcpy(out, suffix->data + ctx->envelope_suffix_pos, n);
+		ctx->envelope_suffix_pos += n;
+		remain -= n;
+	}
+
+	return len - remain;
+}
+
+static int lws_handle_seek (void *userdata, curl_off_t offset, int origin) {
+	lws_ctx_t  *ctx;
+
+	/* rewind only, e.g., when libcurl resends on a stale connection */
+	ctx = userdata;
+	if (offset != 0 || origin != SEEK_SET) {
+		return CURL_SEEKFUNC_CANTSEEK;
+	}
+	ctx->envelope_pos = 0;
+	ctx->resp_body_pos = 0;
+	ctx->envelope_suffix_pos = 0;
+	return CURL_SEEKFUNC_OK;
+}
+
+static size_t lws_handle_upload (char *ptr, size_t size, size_t nmemb, void *userdata) {
+	size_t      n;
+	lws_ctx_t  *ctx;
+
+	/* pause while the response body is still being written */
+	ctx = userdata;
+	n = lws_handle_envelope(ptr, size, nmemb, userdata);
+	if (n == 0 && !ctx->streaming_eof) {
+		ctx->streaming_paused = 1;
+		return CURL_READFUNC_PAUSE;
+	}
+	return n;
+}
+
 
 /*
  * runtime interface
  */
 
 int lws_get_next_invocation (lws_ctx_t *ctx) {
-	char           invocation_url[256], *cookie_ptr, *end;
-	size_t         idx, max, cookie_len, cookie_total_len;
+	char          *end;
 	lws_str_t      key, *value;
-	lws_uint_t     cookie_count;
-	yyjson_val    *root, *request_context, *http, *headers, *cookies, *val, *h_key, *h_val;
 	unsigned long  ul;
 
-	/* prepare invocation URL */
-	snprintf(invocation_url, sizeof(invocation_url), "http://%.*s/%s/runtime/invocation/next",
-			(int)ctx->runtime_api.len, ctx->runtime_api.data, LWS_LAMBDA_RUNTIME_VERSION);
-
-	/* get invocation */
-	lws_curl_reset(ctx);
-	curl_easy_setopt(ctx->curl, CURLOPT_HTTPGET, 1L);
-	curl_easy_setopt(ctx->curl, CURLOPT_URL, invocation_url);
-	curl_easy_setopt(ctx->curl, CURLOPT_SOCKOPTFUNCTION, lws_handle_socket);
-	curl_easy_setopt(ctx->curl, CURLOPT_HEADERFUNCTION, lws_handle_header);
-	curl_easy_setopt(ctx->curl, CURLOPT_HEADERDATA, ctx);
-	curl_easy_setopt(ctx->curl, CURLOPT_WRITEFUNCTION, lws_handle_write);
-	curl_easy_setopt(ctx->curl, CURLOPT_WRITEDATA, ctx);
-	in_poll = 1;
-	if (lws_curl_perform(ctx, LWS_CURL_INITIATE | LWS_CURL_FINALIZE) != 0) {
-		in_poll = 0;
-		return -1;
+	/* get invocation; the poll is cancelled when the event loop is stopped */
+	if (ctx->client) {
+		if (lws_client_get_next(ctx) != 0) {
+			return -1;
+		}
+	} else if (ctx->next_pending) {
+		if (lws_curl_finalize_next(ctx) != 0) {
+			return -1;
+		}
+	} else {
+		lws_curl_next(ctx, ctx->curl);
+		if (lws_curl_perform(ctx, LWS_CURL_INITIATE | LWS_CURL_FINALIZE | LWS_CURL_POLL) != 0) {
+			return -1;
+		}
 	}
-	in_poll = 0;
 
 	/* request ID */
 	lws_str_set(&key, LWS_LAMBDA_REQUEST_ID);
@@ -404,229 +734,50 @@ int lws_get_next_invocation (lws_ctx_t *ctx) {
 		}
 	}
 
-	/* parse inplace */
+	/* scan the envelope; the DOM is parsed in place on first access */
+	lws_profile_phase(LWS_PHASE_PARSE);
 	lws_memzero(ctx->body.data + ctx->body.len, YYJSON_PADDING_SIZE);
-	ctx->doc = yyjson_read_opts(ctx->body.data, ctx->body.len, YYJSON_READ_INSITU, NULL, NULL);
-	if (!ctx->doc) {
-		lws_log(LWS_LOG_ERR, "failed to parse request body as JSON");
-		return -1;
-	}
-
-	/* handle regular and raw mode */
 	if (!ctx->raw) {
 		/* regular mode */
-	
-		/* version */
-		root = yyjson_doc_get_root(ctx->doc);
-		if (!root) {
-			lws_log(LWS_LOG_ERR, "root not found");
-			return -1;
-		}
-		val = yyjson_obj_get(root, "version");
-		if (!val || !yyjson_is_str(val)) {
-			lws_log(LWS_LOG_ERR, "version not found in root");
-			return -1;
-		}
-		if (strcmp(yyjson_get_str(val), LWS_LAMBDA_PAYLOAD_VERSION) != 0) {
-			lws_log(LWS_LOG_ERR, "unsupported payload version:%s", yyjson_get_str(val));
+		if (lws_envelope_scan(ctx) != 0) {
 			return -1;
 		}
+	} else {
+		/* raw mode */
+		lws_str_set(&ctx->req_body, "");
+	}
 
-		/* path */
-		val = yyjson_obj_get(root, "rawPath");
-		if (!val || !yyjson_is_str(val)) {
-			lws_log(LWS_LOG_ERR, "rawPath not found");
-			return -1;
-		}
-		ctx->req_path.data = (char *)yyjson_get_str(val);
-		ctx->req_path.len = yyjson_get_len(val);
+	return 0;
+}
 
-		/* method */
-		request_context = yyjson_obj_get(root, "requestContext");
-		if (!request_context) {
-			lws_log(LWS_LOG_ERR, "requestContext object not found");
-			return -1;
-		}
-		http = yyjson_obj_get(request_context, "http");
-		if (!http) {
-			lws_log(LWS_LOG_ERR, "http object not found");
+static int lws_add_cookie (yyjson_mut_doc *doc, yyjson_mut_val *arr, char *data, size_t start,
+		size_t end) {
+	yyjson_mut_val  *val;
+
+	while (start < end && (data[start] == ' ' || data[start] == '\t')) {
+		start++;
+	}
+	while (end > start && (data[end - 1] == ' ' || data[end - 1] == '\t')) {
+		end--;
+	}
+	if (start < end) {
+		val = yyjson_mut_strn(doc, data + start, end - start);
+		if (!val) {
 			return -1;
 		}
-		val = yyjson_obj_get(http, "method");
-		if (!val || !yyjson_is_str(val)) {
-			lws_log(LWS_LOG_ERR, "method not found");
+		if (!yyjson_mut_arr_add_val(arr, val)) {
 			return -1;
 		}
-		ctx->req_method.data = (char *)yyjson_get_str(val);
-		ctx->req_method.len = yyjson_get_len(val);
+	}
+	return 0;
+}
 
-		/* args */
-		val = yyjson_obj_get(root, "rawQueryString");
-		if (val) {
-			if (!yyjson_is_str(val)) {
-				lws_log(LWS_LOG_ERR, "rawQueryString not a string");
-				return -1;
-			}
-			ctx->req_args.data = (char *)yyjson_get_str(val);
-			ctx->req_args.len = yyjson_get_len(val);
-		} else {
-			lws_str_set(&ctx->req_args, "");
-		}
-
-		/* source IP */
-		val = yyjson_obj_get(http, "sourceIp");
-		if (val) {
-			if (!yyjson_is_str(val)) {
-				lws_log(LWS_LOG_ERR, "sourceIp not a string");
-				return -1;
-			}
-			ctx->req_ip.data = (char *)yyjson_get_str(val);
-			ctx->req_ip.len = yyjson_get_len(val);
-		}
-
-		/* headers */
-		headers = yyjson_obj_get(root, "headers");
-		if (headers) {
-			if (!yyjson_is_obj(headers)) {
-				lws_log(LWS_LOG_ERR, "headers not an object");
-				return -1;
-			}
-			yyjson_obj_foreach(headers, idx, max, h_key, h_val) {
-				if (!yyjson_is_str(h_key) || !yyjson_is_str(h_val)) {
-					lws_log(LWS_LOG_ERR, "header key or value not a string");
-					return -1;
-				}
-				key.data = (char *)yyjson_get_str(h_key);
-				key.len = yyjson_get_len(h_key);
-				value = lws_alloc(sizeof(lws_str_t));
-				if (!value) {
-					return -1;
-				}
-				value->data = (char *)yyjson_get_str(h_val);
-				value->len = yyjson_get_len(h_val);
-				if (lws_table_set(ctx->req_headers, &key, value) != 0) {
-					lws_free(value);
-					return -1;
-				}
-			}
-		}
-
-		/* cookies */
-		cookies = yyjson_obj_get(root, "cookies");
-		if (cookies) {
-			if (!yyjson_is_arr(cookies)) {
-				lws_log(LWS_LOG_ERR, "cookies not an array");
-				return -1;
-			}
-			cookie_total_len = 0;
-			cookie_count = 0;
-			yyjson_arr_foreach(cookies, idx, max, val) {
-				if (!yyjson_is_str(val)) {
-					lws_log(LWS_LOG_ERR, "cookie value not a string");
-					return -1;
-				}
-				cookie_len = yyjson_get_len(val);
-				if (cookie_len == 0) {
-					continue;
-				}
-				if (cookie_len > SIZE_MAX - sizeof(lws_str_t) - 2
-						|| cookie_total_len > SIZE_MAX - sizeof(lws_str_t) - 2 - cookie_len) {
-					lws_log(LWS_LOG_ERR, "cookies header too large");
-					return -1;
-				}
-				cookie_total_len += cookie_len + (cookie_count ? 2 : 0);
-				cookie_count++;
-			}
-			if (cookie_count) {
-				lws_str_set(&key, "Cookie");
-				value = lws_alloc(sizeof(lws_str_t) + cookie_total_len);
-				if (!value) {
-					return -1;
-				}
-				value->data = (char *)value + sizeof(lws_str_t);
-				value->len = cookie_total_len;
-				cookie_ptr = value->data;
-				cookie_count = 0;
-				yyjson_arr_foreach(cookies, idx, max, val) {
-					cookie_len = yyjson_get_len(val);
-					if (cookie_len == 0) {
-						continue;
-					}
-					if (cookie_count) {
-						memcpy(cookie_ptr, ", ", 2);
-						cookie_ptr += 2;
-					}
-					memcpy(cookie_ptr, yyjson_get_str(val), cookie_len);
-					cookie_ptr += cookie_len;
-					cookie_count++;
-				}
-				if (lws_table_set(ctx->req_headers, &key, value) != 0) {
-					lws_free(value);
-					return -1;
-				}
-			}
-		}
-
-		/* request body */
-		val = yyjson_obj_get(root, "body");
-		if (val) {
-			if (!yyjson_is_str(val)) {
-				lws_log(LWS_LOG_ERR, "request body not a string");
-				return -1;
-			}
-			ctx->req_body.data = (char *)yyjson_get_str(val);
-			ctx->req_body.len = yyjson_get_len(val);
-			val = yyjson_obj_get(root, "isBase64Encoded");
-			if (!val || !yyjson_is_bool(val)) {
-				lws_log(LWS_LOG_ERR, "isBase64Encoded not found");
-				return -1;
-			}
-			if (yyjson_is_true(val)) {
-				if (lws_base64_decode((uint8_t *)ctx->req_body.data, &ctx->req_body.len) != 0) {
-					lws_log(LWS_LOG_ERR, "failed to decode base64 request body");
-					return -1;
-				}
-				ctx->req_body.data[ctx->req_body.len] = '\0';
-			}
-		} else {
-			lws_str_set(&ctx->req_body, "");
-		}
-	} else {
-		/* raw mode */
-		lws_str_set(&ctx->req_body, "");
-	}
-
-	return 0;
-}
-
-static int lws_add_cookie (yyjson_mut_doc *doc, yyjson_mut_val *arr, char *data, size_t start,
-		size_t end) {
-	yyjson_mut_val  *val;
-
-	while (start < end && (data[start] == ' ' || data[start] == '\t')) {
-		start++;
-	}
-	while (end > start && (data[end - 1] == ' ' || data[end - 1] == '\t')) {
-		end--;
-	}
-	if (start < end) {
-		val = yyjson_mut_strn(doc, data + start, end - start);
-		if (!val) {
-			return -1;
-		}
-		if (!yyjson_mut_arr_add_val(arr, val)) {
-			return -1;
-		}
-	}
-	return 0;
-}
-
-static int lws_add_headers (lws_ctx_t *ctx, yyjson_mut_doc *doc) {
-	char            *sc_data;
-	void            *value;
-	size_t           sc_len, sc_start, sc_pos;
-	lws_str_t       *key, sc_key, *sc_value;
-	yyjson_mut_val  *root, *headers, *h_key, *h_val, *cookies_arr;
+static int lws_add_headers (lws_ctx_t *ctx, yyjson_mut_doc *doc) {
+	char            *sc_data;
+	void            *value;
+	size_t           sc_len, sc_start, sc_pos;
+	lws_str_t       *key, sc_key, *sc_value;
+	yyjson_mut_val  *root, *headers, *h_key, *h_val, *cookies_arr;
 
 	/* status code */
 	root = yyjson_mut_doc_get_root(doc);
@@ -690,10 +841,125 @@ static int lws_add_headers (lws_ctx_t *ctx, yyjson_mut_doc *doc) {
 	return 0;
 }
 
+static int lws_prepare_envelope (lws_ctx_t *ctx, yyjson_mut_doc *doc, int base64) {
+	char    *json, *envelope;
+	size_t   json_len, len;
+
+	/* write the document and replace its closing brace with the opening of the body */
+	json = yyjson_mut_write_opts(doc, 0, &ctx->json_alc, &json_len, NULL);
+	if (!json) {
+		return -1;
+	}
+	len = json_len - 1 + sizeof(LWS_ENVELOPE_BODY) - 1;
+	envelope = lws_arena_realloc(ctx->json_arena, json, json_len + 1, len);
+	if (!envelope) {
+		return -1;
+	}
+	memcpy(envelope + json_len - 1, LWS_ENVELOPE_BODY, sizeof(LWS_ENVELOPE_BODY) - 1);
+	ctx->envelope.data = envelope;
+	ctx->envelope.len = len;
+	ctx->envelope_pos = 0;
+	if (base64) {
+		lws_str_set(&ctx->envelope_suffix, LWS_ENVELOPE_BASE64);
+	} else {
+		lws_str_set(&ctx->envelope_suffix, LWS_ENVELOPE_TEXT);
+	}
+	ctx->envelope_suffix_pos = 0;
+	ctx->envelope_base64 = base64;
+	return 0;
+}
+
+static int lws_finish_upload (lws_ctx_t *ctx) {
+	int              rc;
+	char            *json, *suffix;
+	size_t           json_len, len;
+	yyjson_mut_doc  *doc;
+	yyjson_mut_val  *root;
+
+	/* init state */
+	rc = -1;
+	doc = NULL;
+
+	/* prepare the members following the body */
+	doc = yyjson_mut_doc_new(&ctx->json_alc);
+	if (!doc) {
+		goto oom;
+	}
+	root = yyjson_mut_obj(doc);
+	if (!root) {
+		goto oom;
+	}
+	yyjson_mut_doc_set_root(doc, root);
+	if (lws_add_headers(ctx, doc) != 0) {
+		goto oom;
+	}
+	json = yyjson_mut_write_opts(doc, 0, &ctx->json_alc, &json_len, NULL);
+	if (!json) {
+		goto oom;
+	}
+
+	/* append the suffix to the envelope prefix, replacing the braces of the document */
+	len = 2 + json_len - 2 + sizeof(LWS_UPLOAD_TAIL) - 1;
+	suffix = lws_arena_realloc(ctx->json_arena, ctx->envelope.data, ctx->envelope.len,
+			ctx->envelope.len + len);
+	if (!suffix) {
+		goto oom;
+	}
+	ctx->envelope.data = suffix;
+	suffix += ctx->envelope.len;
+	memcpy(suffix, "\",", 2);
+	memcpy(suffix + 2, json + 1, json_len - 2);
+	memcpy(suffix + json_len, LWS_UPLOAD_TAIL, sizeof(LWS_UPLOAD_TAIL) - 1);
+	ctx->envelope_suffix.data = suffix;
+	ctx->envelope_suffix.len = len;
+	ctx->envelope_suffix_pos = 0;
+
+	/* send the rest of the body and the suffix */
+	ctx->streaming_eof = 1;
+	if (ctx->client) {
+		ctx->streaming_paused = 0;
+		ctx->uploading = 0;
+		if (lws_client_stream(ctx, lws_handle_upload, ctx, 1) != 0) {
+			goto cleanup;
+		}
+	} else {
+		if (ctx->streaming_paused) {
+			if (curl_easy_pause(ctx->curl, CURLPAUSE_CONT) != CURLE_OK) {
+				lws_log(LWS_LOG_ERR, "failed to resume progressive upload");
+				goto cleanup;
+			}
+			ctx->streaming_paused = 0;
+		}
+		rc = ctx->curl_next ? lws_curl_overlap(ctx) : lws_curl_perform(ctx, LWS_CURL_FINALIZE);
+		ctx->uploading = 0;
+		if (rc != 0) {
+			goto cleanup;
+		}
+	}
+
+	/* successfully posted response */
+	rc = 0;
+	goto cleanup;
+
+	oom:
+	lws_log(LWS_LOG_CRIT, "out of memory");
+
+	cleanup:
+	if (ctx->uploading) {
+		lws_abort_upload(ctx);
+	}
+	if (doc) {
+		yyjson_mut_doc_free(doc);
+	}
+
+	return rc;
+}
+
 int lws_post_response (lws_ctx_t *ctx) {
-	int                 rc, base64;
-	char                response_url[256], *resp_body_new, *json, *post;
-	size_t              base64_len, json_len, post_len;
+	int                 rc, base64, in_place;
+	char                response_url[256], *json, *post;
+	size_t              body_len, json_len, post_len;
+	struct iovec        iov[3];
 	yyjson_mut_doc     *doc;
 	yyjson_mut_val     *root;
 	struct curl_slist  *curl_headers;
@@ -702,18 +968,26 @@ int lws_post_response (lws_ctx_t *ctx) {
 	rc = -1;
 	curl_headers = NULL;
 	doc = NULL;
-	json = NULL;
-
-	/* prepare response URL */
-	snprintf(response_url, sizeof(response_url),
-			"http://%.*s/%s/runtime/invocation/%.*s/response", (int)ctx->runtime_api.len,
-			ctx->runtime_api.data, LWS_LAMBDA_RUNTIME_VERSION, (int)ctx->request_id->len,
-			ctx->request_id->data);
+	post = NULL;
+	post_len = 0;
+	in_place = 0;
+	lws_profile_phase(LWS_PHASE_SERIALIZE);
+
+	/* complete a progressive upload, unless the body ends in an incomplete sequence */
+	if (ctx->uploading) {
+		if (ctx->resp_body_utf8 == LWS_UTF8_ACCEPT) {
+			return lws_finish_upload(ctx);
+		}
+		lws_abort_upload(ctx);
+	}
+	if (ctx->upload_dropped) {
+		lws_log(LWS_LOG_ERR, "response cannot be posted after a dropped progressive upload");
+		return -1;
+	}
 
-	/* prepare Lambda headers */
-	curl_headers = curl_slist_append(curl_headers, "Content-Type: application/json");
-	if (!curl_headers) {
-		goto oom;
+	/* compress */
+	if (lws_compress_prepare(ctx, 0) != 0 || lws_compress_body(ctx, 1) != 0) {
+		goto cleanup;
 	}
 
 	/* handle regular and raw mode */
@@ -721,7 +995,7 @@ int lws_post_response (lws_ctx_t *ctx) {
 		/* regular mode */
 
 		/* prepare Lambda body */
-		doc = yyjson_mut_doc_new(NULL);
+		doc = yyjson_mut_doc_new(&ctx->json_alc);
 		if (!doc) {
 			goto oom;
 		}
@@ -736,34 +1010,40 @@ int lws_post_response (lws_ctx_t *ctx) {
 			goto oom;
 		}
 
-		/* body */
-		base64 = lws_valid_utf8((uint8_t *)ctx->resp_body.data, ctx->resp_body.len) != 0;
+		/* body encoding; the UTF-8 state and escaped length usually cover the body already */
+		ctx->resp_body_utf8 = lws_utf8_escape_update(ctx->resp_body_utf8,
+				(uint8_t *)ctx->resp_body.data + ctx->resp_body_utf8_pos,
+				ctx->resp_body.len - ctx->resp_body_utf8_pos, &ctx->resp_body_escaped);
+		ctx->resp_body_utf8_pos = ctx->resp_body.len;
+		base64 = ctx->resp_body_utf8 != LWS_UTF8_ACCEPT;
 		if (base64) {
-			if (lws_base64_encode_len(ctx->resp_body.len, &base64_len) != 0) {
+			if (lws_base64_encode_len(ctx->resp_body.len, &body_len) != 0) {
 				lws_log(LWS_LOG_ERR, "response body base64 encoding too large");
 				goto cleanup;
 			}
-			if (ctx->resp_body_cap < base64_len) {
-				resp_body_new = lws_realloc(ctx->resp_body.data, base64_len);
-				if (!resp_body_new) {
-					goto cleanup;
-				}
-				ctx->resp_body.data = resp_body_new;
-				ctx->resp_body_cap = base64_len;
+		} else {
+			if (ctx->resp_body.len > SIZE_MAX / 6) {
+				lws_log(LWS_LOG_ERR, "response body JSON encoding too large");
+				goto cleanup;
 			}
-			lws_base64_encode((uint8_t *)ctx->resp_body.data, &ctx->resp_body.len);
+			body_len = ctx->resp_body_escaped;
 		}
-		if (!yyjson_mut_obj_add_strn(doc, root, "body", ctx->resp_body.data, ctx->resp_body.len)) {
+
+		/* envelope; the body is encoded into the request as it is sent */
+		if (lws_prepare_envelope(ctx, doc, base64) != 0) {
 			goto oom;
 		}
-		if (!yyjson_mut_obj_add_bool(doc, root, "isBase64Encoded", base64)) {
-			goto oom;
+		if (body_len > LWS_CURL_OFF_T_MAX - ctx->envelope.len - ctx->envelope_suffix.len) {
+			lws_log(LWS_LOG_ERR, "response JSON too large len:%zu", body_len);
+			goto cleanup;
 		}
+		post_len = ctx->envelope.len + body_len + ctx->envelope_suffix.len;
+		in_place = !base64 && body_len == ctx->resp_body.len;
 	} else {
 		/* raw mode */
 		if (ctx->resp_body.len == 0) {
 			/* no response body -> send JSON null */
-			doc = yyjson_mut_doc_new(NULL);
+			doc = yyjson_mut_doc_new(&ctx->json_alc);
 			if (!doc) {
 				goto oom;
 			}
@@ -772,6 +1052,12 @@ int lws_post_response (lws_ctx_t *ctx) {
 				goto oom;
 			}
 			yyjson_mut_doc_set_root(doc, root);
+			json = yyjson_mut_write_opts(doc, 0, &ctx->json_alc, &json_len, NULL);
+			if (!json) {
+				goto oom;
+			}
+			post = json;
+			post_len = json_len;
 		} else {
 			/* send response body directly */
 			if (ctx->resp_body.len > LWS_CURL_OFF_T_MAX) {
@@ -783,29 +1069,62 @@ int lws_post_response (lws_ctx_t *ctx) {
 		}
 	}
 
-	/* create JSON */
-	if (doc) {
-		json = yyjson_mut_write(doc, 0, &json_len);
-		if (!json) {
+	/* post response */
+	lws_profile_phase(LWS_PHASE_POST);
+	if (ctx->client) {
+		if (post) {
+			iov[0].iov_base = post;
+			iov[0].iov_len = post_len;
+			if (lws_client_post(ctx, LWS_CLIENT_RESPONSE, LWS_JSON_CT "\r\n", iov, 1) != 0) {
+				goto cleanup;
+			}
+		} else if (in_place) {
+			/* no escaping required; send the body in place */
+			iov[0].iov_base = ctx->envelope.data;
+			iov[0].iov_len = ctx->envelope.len;
+			iov[1].iov_base = ctx->resp_body.data;
+			iov[1].iov_len = ctx->resp_body.len;
+			iov[2].iov_base = ctx->envelope_suffix.data;
+			iov[2].iov_len = ctx->envelope_suffix.len;
+			if (lws_client_post(ctx, LWS_CLIENT_RESPONSE, LWS_JSON_CT "\r\n", iov, 3) != 0) {
+				goto cleanup;
+			}
+		} else {
+			if (lws_client_begin(ctx, LWS_CLIENT_RESPONSE, LWS_JSON_CT "\r\n", (off_t)post_len)
+					!= 0 || lws_client_stream(ctx, lws_handle_envelope, ctx, 1) != 0) {
+				goto cleanup;
+			}
+		}
+	} else {
+		snprintf(response_url, sizeof(response_url),
+				"http://%.*s/%s/runtime/invocation/%.*s/response", (int)ctx->runtime_api.len,
+				ctx->runtime_api.data, LWS_LAMBDA_RUNTIME_VERSION, (int)ctx->request_id->len,
+				ctx->request_id->data);
+		curl_headers = curl_slist_append(curl_headers, LWS_JSON_CT);
+		if (!curl_headers) {
+			goto oom;
+		}
+		curl_headers = curl_slist_append(curl_headers, "Expect:");  /* no "Expect: 100-continue" */
+		if (!curl_headers) {
 			goto oom;
 		}
-		if (json_len > LWS_CURL_OFF_T_MAX) {
-			lws_log(LWS_LOG_ERR, "response JSON too large len:%zu", json_len);
+		lws_curl_reset(ctx->curl);
+		curl_easy_setopt(ctx->curl, CURLOPT_POST, 1L);
+		curl_easy_setopt(ctx->curl, CURLOPT_URL, response_url);
+		curl_easy_setopt(ctx->curl, CURLOPT_HTTPHEADER, curl_headers);
+		if (post) {
+			curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDS, post);
+		} else {
+			curl_easy_setopt(ctx->curl, CURLOPT_READFUNCTION, lws_handle_envelope);
+			curl_easy_setopt(ctx->curl, CURLOPT_READDATA, ctx);
+			curl_easy_setopt(ctx->curl, CURLOPT_SEEKFUNCTION, lws_handle_seek);
+			curl_easy_setopt(ctx->curl, CURLOPT_SEEKDATA, ctx);
+		}
+		curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)post_len);
+		if ((ctx->curl_next ? lws_curl_overlap(ctx)
+				: lws_curl_perform(ctx, LWS_CURL_INITIATE | LWS_CURL_FINALIZE)) != 0) {
 			goto cleanup;
 		}
-		post = json;
-		post_len = json_len;
-	}
-
-	/* post response */
-	lws_curl_reset(ctx);
-	curl_easy_setopt(ctx->curl, CURLOPT_POST, 1L);
-	curl_easy_setopt(ctx->curl, CURLOPT_URL, response_url);
-	curl_easy_setopt(ctx->curl, CURLOPT_HTTPHEADER, curl_headers);
-	curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDS, post);
-	curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)post_len);
-	if (lws_curl_perform(ctx, LWS_CURL_INITIATE | LWS_CURL_FINALIZE) != 0) {
-		goto cleanup;
 	}
 
 	/* successfully posted response */
@@ -822,19 +1141,374 @@ int lws_post_response (lws_ctx_t *ctx) {
 	if (doc) {
 		yyjson_mut_doc_free(doc);
 	}
-	if (json) {
-		lws_free(json);
+
+	return rc;
+}
+
+static int lws_stream_begin (lws_ctx_t *ctx, lws_client_read_pt read) {
+	int                 rc;
+	char                response_url[256];
+	struct curl_slist  *curl_headers;
+
+	/* native client */
+	if (ctx->client) {
+		if (lws_client_begin(ctx, LWS_CLIENT_RESPONSE, LWS_LAMBDA_STREAMING_CT "\r\n"
+				LWS_LAMBDA_STREAMING_MODE "\r\n", -1) != 0) {
+			return -1;
+		}
+		return lws_client_stream(ctx, read, ctx, 0);
+	}
+
+	/* libcurl */
+	rc = -1;
+	curl_headers = NULL;
+	snprintf(response_url, sizeof(response_url), "http://%.*s/%s/runtime/invocation/%.*s/response",
+			(int)ctx->runtime_api.len, ctx->runtime_api.data, LWS_LAMBDA_RUNTIME_VERSION,
+			(int)ctx->request_id->len, ctx->request_id->data);
+	curl_headers = curl_slist_append(curl_headers, LWS_LAMBDA_STREAMING_CT);
+	if (!curl_headers) {
+		goto oom;
+	}
+	curl_headers = curl_slist_append(curl_headers, LWS_LAMBDA_STREAMING_MODE);
+	if (!curl_headers) {
+		goto oom;
+	}
+	curl_headers = curl_slist_append(curl_headers, "Expect:");  /* no "Expect: 100-continue" */
+	if (!curl_headers) {
+		goto oom;
+	}
+	lws_curl_reset(ctx->curl);
+	curl_easy_setopt(ctx->curl, CURLOPT_POST, 1L);
+	curl_easy_setopt(ctx->curl, CURLOPT_URL, response_url);
+	curl_easy_setopt(ctx->curl, CURLOPT_HTTPHEADER, curl_headers);
+	curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)-1);
+	curl_easy_setopt(ctx->curl, CURLOPT_READFUNCTION, read);
+	curl_easy_setopt(ctx->curl, CURLOPT_READDATA, ctx);
+	rc = lws_curl_perform(ctx, LWS_CURL_INITIATE);
+	goto cleanup;
+
+	oom:
+	lws_log(LWS_LOG_CRIT, "out of memory");
+
+	cleanup:
+	if (curl_headers != NULL) {
+		curl_slist_free_all(curl_headers);
+	}
+	return rc;
+}
+
+static void lws_compact_stream (lws_ctx_t *ctx) {
+	/* sent data is not retained; the buffer is reused from the start */
+	if (ctx->resp_body_pos == ctx->resp_body.len) {
+		ctx->resp_body.len = 0;
+		ctx->resp_body_pos = 0;
+	}
+}
+
+static int lws_stream_resume (lws_ctx_t *ctx, lws_client_read_pt read, int finish) {
+	if (ctx->client) {
+		ctx->streaming_paused = 0;
+		return lws_client_stream(ctx, read, ctx, finish);
+	}
+	if (ctx->streaming_paused) {
+		if (curl_easy_pause(ctx->curl, CURLPAUSE_CONT) != CURLE_OK) {
+			lws_log(LWS_LOG_ERR, "failed to resume streaming response");
+			return -1;
+		}
+		ctx->streaming_paused = 0;
+	}
+	return lws_curl_perform(ctx, finish ? LWS_CURL_FINALIZE : 0);
+}
+
+static void lws_schedule_ping (lws_sender_t *s) {
+	clock_gettime(CLOCK_MONOTONIC, &s->ping_at);
+	s->ping_at.tv_sec += s->heartbeat / 1000;
+	s->ping_at.tv_nsec += (s->heartbeat % 1000) * 1000000;
+	if (s->ping_at.tv_nsec >= 1000000000) {
+		s->ping_at.tv_sec++;
+		s->ping_at.tv_nsec -= 1000000000;
+	}
+}
+
+static void *lws_send_stream (void *userdata) {
+	int                  timedout;
+	lws_ctx_t           *ctx;
+	lws_sender_t        *s;
+	lws_stream_chunk_t  *chunk;
+
+	/* initiate the request with the prelude */
+	ctx = userdata;
+	s = ctx->sender;
+	if (lws_stream_begin(ctx, lws_handle_queue) != 0) {
+		goto failed;
+	}
+	if (s->heartbeat) {
+		lws_schedule_ping(s);
+	}
+
+	/* send chunks until the end of the stream */
+	while (1) {
+		pthread_mutex_lock(&s->mutex);
+		timedout = 0;
+		while (!s->head && !s->eof && !s->stop && !timedout) {
+			if (s->heartbeat) {
+				timedout = pthread_cond_timedwait(&s->cond, &s->mutex, &s->ping_at)
+						== ETIMEDOUT;
+			} else {
+				pthread_cond_wait(&s->cond, &s->mutex);
+			}
+		}
+		if (s->stop) {
+			pthread_mutex_unlock(&s->mutex);
+			goto failed;
+		}
+		chunk = s->head;
+		if (chunk) {
+			s->head = chunk->next;
+			if (!s->head) {
+				s->tail = NULL;
+			}
+		}
+		pthread_mutex_unlock(&s->mutex);
+
+		/* idle: send a heartbeat, unless within a line */
+		if (!chunk && timedout) {
+			if (s->lf) {
+				s->ping->pos = 0;
+				s->chunk = s->ping;
+				if (lws_stream_resume(ctx, lws_handle_queue, 0) != 0) {
+					goto failed;
+				}
+				s->chunk = NULL;
+			}
+			lws_schedule_ping(s);
+			continue;
+		}
+
+		/* send chunk, or end the stream */
+		s->chunk = chunk;
+		s->done = chunk == NULL;
+		if (lws_stream_resume(ctx, lws_handle_queue, chunk == NULL) != 0) {
+			goto failed;
+		}
+		if (!chunk) {
+			return NULL;
+		}
+		s->chunk = NULL;
+		s->lf = chunk->data[chunk->len - 1] == '\n';
+		if (s->heartbeat) {
+			lws_schedule_ping(s);
+		}
+		pthread_mutex_lock(&s->mutex);
+		s->queued -= chunk->len;
+		pthread_cond_broadcast(&s->cond);
+		pthread_mutex_unlock(&s->mutex);
+		lws_free(chunk);
+	}
+
+	failed:
+	if (s->chunk && s->chunk != s->ping) {
+		lws_free(s->chunk);
+	}
+	s->chunk = NULL;
+	pthread_mutex_lock(&s->mutex);
+	s->failed = 1;
+	while ((chunk = s->head)) {
+		s->head = chunk->next;
+		lws_free(chunk);
+	}
+	s->tail = NULL;
+	s->queued = 0;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+	return NULL;
+}
+
+static int lws_enqueue_stream (lws_ctx_t *ctx, const char *data, size_t len, int finish) {
+	int                  rc;
+	lws_sender_t        *s;
+	lws_stream_chunk_t  *chunk;
+
+	/* copy the data into an immutable chunk */
+	rc = 0;
+	s = ctx->sender;
+	chunk = NULL;
+	if (len) {
+		chunk = lws_alloc(sizeof(lws_stream_chunk_t) + len);
+		if (chunk) {
+			chunk->next = NULL;
+			chunk->len = len;
+			chunk->pos = 0;
+			memcpy(chunk->data, data, len);
+		} else {
+			lws_log(LWS_LOG_CRIT, "out of memory");
+			rc = -1;
+		}
+	}
+
+	/* enqueue, blocking while the queue is full; an oversized chunk is accepted alone */
+	pthread_mutex_lock(&s->mutex);
+	while (chunk && s->queued && s->queued + len > s->max && !s->failed) {
+		pthread_cond_wait(&s->cond, &s->mutex);
+	}
+	if (s->failed) {
+		rc = -1;
+	} else if (chunk) {
+		if (s->tail) {
+			s->tail->next = chunk;
+		} else {
+			s->head = chunk;
+		}
+		s->tail = chunk;
+		s->queued += len;
+		chunk = NULL;
+	}
+	if (finish) {
+		s->eof = 1;
+	}
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+	if (chunk) {
+		lws_free(chunk);
+	}
+
+	/* wait for the sender thread to complete the request */
+	if (finish && lws_join_sender(ctx) != 0) {
+		rc = -1;
+	}
+
+	return rc;
+}
+
+static int lws_queue_stream (lws_ctx_t *ctx, int finish) {
+	int  rc;
+
+	/* move the data written since the last flush into the queue */
+	rc = lws_enqueue_stream(ctx, ctx->resp_body.data, ctx->resp_body.len, finish);
+	ctx->resp_body.len = 0;
+	return rc;
+}
+
+static int lws_start_sender (lws_ctx_t *ctx) {
+	lws_str_t           *value, key;
+	lws_sender_t        *s;
+	pthread_condattr_t   attr;
+
+	/* sender */
+	s = lws_calloc(sizeof(lws_sender_t));
+	if (!s) {
+		goto oom;
+	}
+	s->max = ctx->stream_queue;
+	s->lf = 1;
+
+	/* SSE heartbeat */
+	lws_str_set(&key, "Content-Type");
+	value = lws_table_get(ctx->resp_headers, &key);
+	if (ctx->stream_heartbeat && value && value->len >= sizeof(LWS_SSE_CT) - 1
+			&& lws_strncasecmp(value->data, LWS_SSE_CT, sizeof(LWS_SSE_CT) - 1) == 0) {
+		s->ping = lws_alloc(sizeof(lws_stream_chunk_t) + sizeof(LWS_SSE_HEARTBEAT) - 1);
+		if (!s->ping) {
+			goto oom;
+		}
+		s->ping->next = NULL;
+		s->ping->len = sizeof(LWS_SSE_HEARTBEAT) - 1;
+		memcpy(s->ping->data, LWS_SSE_HEARTBEAT, s->ping->len);
+		s->heartbeat = ctx->stream_heartbeat;
+	}
+
+	/* synchronization; heartbeats are timed on the monotonic clock */
+	if (pthread_mutex_init(&s->mutex, NULL) != 0) {
+		goto error;
+	}
+	if (pthread_condattr_init(&attr) != 0) {
+		pthread_mutex_destroy(&s->mutex);
+		goto error;
+	}
+	if (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0
+			|| pthread_cond_init(&s->cond, &attr) != 0) {
+		pthread_condattr_destroy(&attr);
+		pthread_mutex_destroy(&s->mutex);
+		goto error;
+	}
+	pthread_condattr_destroy(&attr);
+
+	/* thread */
+	ctx->sender = s;
+	if (pthread_create(&s->thread, NULL, lws_send_stream, ctx) != 0) {
+		ctx->sender = NULL;
+		pthread_cond_destroy(&s->cond);
+		pthread_mutex_destroy(&s->mutex);
+		goto error;
+	}
+	return 0;
+
+	oom:
+	lws_log(LWS_LOG_CRIT, "out of memory");
+	goto cleanup;
+
+	error:
+	lws_log(LWS_LOG_ERR, "failed to create streaming sender thread");
+
+	cleanup:
+	if (s) {
+		if (s->ping) {
+			lws_free(s->ping);
+		}
+		lws_free(s);
 	}
+	return -1;
+}
 
+static int lws_join_sender (lws_ctx_t *ctx) {
+	int            rc;
+	lws_sender_t  *s;
+
+	/* the runtime API client returns to this thread */
+	s = ctx->sender;
+	pthread_join(s->thread, NULL);
+	rc = s->failed ? -1 : 0;
+	pthread_cond_destroy(&s->cond);
+	pthread_mutex_destroy(&s->mutex);
+	if (s->ping) {
+		lws_free(s->ping);
+	}
+	lws_free(s);
+	ctx->sender = NULL;
 	return rc;
 }
 
+void lws_stop_sender (lws_ctx_t *ctx) {
+	lws_sender_t  *s;
+
+	/* no sender thread? */
+	s = ctx->sender;
+	if (!s) {
+		return;
+	}
+
+	/* drop the stream, unless already complete */
+	pthread_mutex_lock(&s->mutex);
+	s->eof = 1;
+	s->stop = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+	lws_join_sender(ctx);
+
+	/* drop the partial request */
+	if (ctx->client) {
+		lws_client_abort(ctx->client);
+	} else {
+		curl_multi_remove_handle(ctx->curlm, ctx->curl);
+	}
+	ctx->streaming_paused = 0;
+	lws_log_debug("streaming sender stopped");
+}
+
 int lws_stream_response (lws_ctx_t *ctx, int finish) {
 	int                 rc;
-	char                response_url[256];
 	yyjson_mut_doc     *doc;
 	yyjson_mut_val     *root;
-	struct curl_slist  *curl_headers;
 
 	/* raw mode? */
 	if (ctx->raw) {
@@ -844,43 +1518,45 @@ int lws_stream_response (lws_ctx_t *ctx, int finish) {
 
 	/* already streaming? */
 	if (ctx->streaming) {
-		if (ctx->streaming_paused) {
-			if (curl_easy_pause(ctx->curl, CURLPAUSE_CONT) != CURLE_OK) {
-				lws_log(LWS_LOG_ERR, "failed to resume streaming response");
+		if (lws_compress_body(ctx, finish) != 0) {
+			lws_stop_sender(ctx);
+			return -1;
+		}
+		if (ctx->sender) {
+			if (lws_queue_stream(ctx, finish) != 0) {
+				lws_stop_sender(ctx);
 				return -1;
 			}
-			ctx->streaming_paused = 0;
+			return 0;
+		}
+		if (finish) {
+			ctx->streaming_eof = 1;
 		}
-		return lws_curl_perform(ctx, finish ? LWS_CURL_FINALIZE : 0);
+		if (lws_stream_resume(ctx, lws_handle_read, finish) != 0) {
+			return -1;
+		}
+		lws_compact_stream(ctx);
+		return 0;
+	}
+
+	/* streaming replaces a progressive upload, unless the upload has sent data */
+	lws_abort_upload(ctx);
+	if (ctx->upload_dropped) {
+		lws_log(LWS_LOG_ERR, "streaming not possible after a dropped progressive upload");
+		return -1;
 	}
 
 	/* init state */
 	rc = -1;
-	curl_headers = NULL;
 	doc = NULL;
 
-	/* prepare response URL */
-	snprintf(response_url, sizeof(response_url),
-			"http://%.*s/%s/runtime/invocation/%.*s/response", (int)ctx->runtime_api.len,
-			ctx->runtime_api.data, LWS_LAMBDA_RUNTIME_VERSION, (int)ctx->request_id->len,
-			ctx->request_id->data);
-
-	/* prepare Lambda headers */
-	curl_headers = curl_slist_append(curl_headers, LWS_LAMBDA_STREAMING_CT);
-	if (!curl_headers) {
-		goto oom;
-	}
-	curl_headers = curl_slist_append(curl_headers, LWS_LAMBDA_STREAMING_MODE);
-	if (!curl_headers) {
-		goto oom;
-	}
-	curl_headers = curl_slist_append(curl_headers, "Expect:");  /* prevent "Expect: 100-continue" */
-	if (!curl_headers) {
-		goto oom;
+	/* compress; each flush completes a block */
+	if (lws_compress_prepare(ctx, 1) != 0 || lws_compress_body(ctx, finish) != 0) {
+		goto cleanup;
 	}
 
 	/* prepare Lambda body */
-	doc = yyjson_mut_doc_new(NULL);
+	doc = yyjson_mut_doc_new(&ctx->json_alc);
 	if (!doc) {
 		goto oom;
 	}
@@ -896,22 +1572,28 @@ int lws_stream_response (lws_ctx_t *ctx, int finish) {
 	}
 
 	/* create JSON */
-	ctx->streaming_prelude.data = yyjson_mut_write(doc, 0, &ctx->streaming_prelude.len);
+	ctx->streaming_prelude.data = yyjson_mut_write_opts(doc, 0, &ctx->json_alc,
+			&ctx->streaming_prelude.len, NULL);
 	if (!ctx->streaming_prelude.data) {
 		goto oom;
 	}
 
-	/* initiate posting of streaming response */
-	lws_curl_reset(ctx);
-	curl_easy_setopt(ctx->curl, CURLOPT_POST, 1L);
-	curl_easy_setopt(ctx->curl, CURLOPT_URL, response_url);
-	curl_easy_setopt(ctx->curl, CURLOPT_HTTPHEADER, curl_headers);
-	curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)-1);
-	curl_easy_setopt(ctx->curl, CURLOPT_READFUNCTION, lws_handle_read);
-	curl_easy_setopt(ctx->curl, CURLOPT_READDATA, ctx);
-	if (lws_curl_perform(ctx, LWS_CURL_INITIATE) != 0) {
+	/* initiate posting of streaming response, inline or through the sender thread */
+	if (ctx->stream_queue) {
+		ctx->streaming = 1;
+		if (lws_start_sender(ctx) != 0) {
+			ctx->streaming = 0;
+			goto cleanup;
+		}
+		if ((rc = lws_queue_stream(ctx, finish)) != 0) {
+			lws_stop_sender(ctx);
+		}
 		goto cleanup;
 	}
+	if (lws_stream_begin(ctx, lws_handle_read) != 0) {
+		goto cleanup;
+	}
+	lws_compact_stream(ctx);
 
 	/* successfully initiated streaming response */
 	ctx->streaming = 1;
@@ -922,9 +1604,6 @@ int lws_stream_response (lws_ctx_t *ctx, int finish) {
 	lws_log(LWS_LOG_CRIT, "out of memory");
 
 	cleanup:
-	if (curl_headers != NULL) {
-		curl_slist_free_all(curl_headers);
-	}
 	if (doc) {
 		yyjson_mut_doc_free(doc);
 	}
@@ -932,14 +1611,165 @@ int lws_stream_response (lws_ctx_t *ctx, int finish) {
 	return rc;
 }
 
+int lws_pull_response (lws_ctx_t *ctx, lws_producer_pt producer, void *userdata) {
+	int        rc;
+	lws_str_t  chunk;
+
+	/* start streaming, or flush, with the data written so far */
+	if (lws_stream_response(ctx, 0) != 0) {
+		return -1;
+	}
+
+	/* sender thread: pull on this thread, with backpressure from the queue bound */
+	if (ctx->sender) {
+		while ((rc = producer(userdata, &chunk)) == 0) {
+			if (ctx->compressor && lws_compress_update(ctx->compressor, chunk.data, chunk.len, 0,
+					&chunk) != 0) {
+				rc = -1;
+				break;
+			}
+			if (chunk.len && lws_enqueue_stream(ctx, chunk.data, chunk.len, 0) != 0) {
+				rc = -1;
+				break;
+			}
+		}
+		if (rc < 0) {
+			lws_stop_sender(ctx);
+			return -1;
+		}
+		return 0;
+	}
+
+	/* inline: the read function pulls whenever the transport accepts more data */
+	rc = 0;
+	ctx->producer = producer;
+	ctx->producer_data = userdata;
+	while (ctx->producer) {
+		if (lws_stream_resume(ctx, lws_handle_read, 0) != 0) {
+			rc = -1;
+			break;
+		}
+		if (!ctx->streaming_paused) {
+			lws_log(LWS_LOG_ERR, "streaming response ended while pulling");
+			rc = -1;
+			break;
+		}
+	}
+	lws_compact_stream(ctx);
+	ctx->producer = NULL;
+	ctx->producer_data = NULL;
+	lws_str_null(&ctx->produced);
+	ctx->produced_pos = 0;
+	return rc;
+}
+
+int lws_upload_response (lws_ctx_t *ctx) {
+	char                response_url[256];
+	struct curl_slist  *curl_headers;
+
+	/* already uploading? */
+	if (ctx->uploading) {
+		if (ctx->client) {
+			ctx->streaming_paused = 0;
+			return lws_client_stream(ctx, lws_handle_upload, ctx, 0);
+		}
+		if (ctx->streaming_paused) {
+			if (curl_easy_pause(ctx->curl, CURLPAUSE_CONT) != CURLE_OK) {
+				lws_log(LWS_LOG_ERR, "failed to resume progressive upload");
+				return -1;
+			}
+			ctx->streaming_paused = 0;
+		}
+		return lws_curl_perform(ctx, 0);
+	}
+
+	/* envelope prefix; the other members follow the body */
+	ctx->envelope.data = lws_arena_alloc(ctx->json_arena, sizeof(LWS_UPLOAD_BODY) - 1);
+	if (!ctx->envelope.data) {
+		return -1;
+	}
+	memcpy(ctx->envelope.data, LWS_UPLOAD_BODY, sizeof(LWS_UPLOAD_BODY) - 1);
+	ctx->envelope.len = sizeof(LWS_UPLOAD_BODY) - 1;
+	ctx->envelope_pos = 0;
+	lws_str_null(&ctx->envelope_suffix);
+	ctx->envelope_suffix_pos = 0;
+	ctx->envelope_base64 = 0;
+	ctx->resp_body_pos = 0;
+	ctx->uploading = 1;
+	lws_log_debug("progressive upload len:%zu", ctx->resp_body.len);
+
+	/* initiate progressive upload; the caller aborts on failure */
+	if (ctx->client) {
+		if (lws_client_begin(ctx, LWS_CLIENT_RESPONSE, LWS_JSON_CT "\r\n", -1) != 0) {
+			return -1;
+		}
+		return lws_client_stream(ctx, lws_handle_upload, ctx, 0);
+	}
+	snprintf(response_url, sizeof(response_url), "http://%.*s/%s/runtime/invocation/%.*s/response",
+			(int)ctx->runtime_api.len, ctx->runtime_api.data, LWS_LAMBDA_RUNTIME_VERSION,
+			(int)ctx->request_id->len, ctx->request_id->data);
+	curl_headers = curl_slist_append(NULL, LWS_JSON_CT);
+	if (curl_headers) {
+		curl_headers = curl_slist_append(curl_headers, "Expect:");  /* no "Expect: 100-continue" */
+	}
+	if (!curl_headers) {
+		lws_log(LWS_LOG_CRIT, "out of memory");
+		return -1;
+	}
+	lws_curl_reset(ctx->curl);
+	curl_easy_setopt(ctx->curl, CURLOPT_POST, 1L);
+	curl_easy_setopt(ctx->curl, CURLOPT_URL, response_url);
+	curl_easy_setopt(ctx->curl, CURLOPT_HTTPHEADER, curl_headers);
+	curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)-1);
+	curl_easy_setopt(ctx->curl, CURLOPT_READFUNCTION, lws_handle_upload);
+	curl_easy_setopt(ctx->curl, CURLOPT_READDATA, ctx);
+	if (lws_curl_perform(ctx, LWS_CURL_INITIATE) != 0) {
+		curl_slist_free_all(curl_headers);
+		return -1;
+	}
+	curl_slist_free_all(curl_headers);  /* sent by the time the upload pauses */
+	return 0;
+}
+
+void lws_abort_upload (lws_ctx_t *ctx) {
+	/* no further progressive upload for this invocation */
+	ctx->upload_skip = 1;
+	if (!ctx->uploading) {
+		return;
+	}
+
+	/* drop the partial request; as the runtime API may have seen part of the response, the
+	 * invocation can only fail with an error */
+	if (ctx->client) {
+		lws_client_abort(ctx->client);
+	} else {
+		curl_multi_remove_handle(ctx->curlm, ctx->curl);
+	}
+	lws_str_null(&ctx->envelope);
+	ctx->envelope_pos = 0;
+	lws_str_null(&ctx->envelope_suffix);
+	ctx->envelope_suffix_pos = 0;
+	ctx->resp_body_pos = 0;
+	ctx->streaming_paused = 0;
+	ctx->streaming_eof = 0;
+	ctx->uploading = 0;
+	ctx->upload_dropped = 1;
+	lws_log_debug("progressive upload aborted");
+}
+
 int lws_post_error (lws_ctx_t *ctx, const char *error_message) {
 	int                 rc;
 	char                error_url[256], *json;
 	size_t              json_len;
 	yyjson_mut_doc     *doc;
 	yyjson_mut_val     *root, *arr;
+	struct iovec        iov[1];
 	struct curl_slist  *curl_headers;
 
+	/* drop a progressive upload or a streaming sender thread */
+	lws_abort_upload(ctx);
+	lws_stop_sender(ctx);
+
 	/* log error, prepare error url */
 	if (!ctx->request_id) {
 		lws_log(LWS_LOG_EMERG, "initialization error msg:%s", error_message);
@@ -956,16 +1786,9 @@ int lws_post_error (lws_ctx_t *ctx, const char *error_message) {
 	rc = -1;
 	curl_headers = NULL;
 	doc = NULL;
-	json = NULL;
-
-	/* prepare headers */
-	curl_headers = curl_slist_append(curl_headers, "Content-Type: application/json");
-	if (!curl_headers) {
-		goto oom;
-	}
 
 	/* create error document */
-	doc = yyjson_mut_doc_new(NULL);
+	doc = yyjson_mut_doc_new(&ctx->json_alc);
 	if (!doc) {
 		goto oom;
 	}
@@ -989,7 +1812,7 @@ int lws_post_error (lws_ctx_t *ctx, const char *error_message) {
 	}
 
 	/* create JSON */
-	json = yyjson_mut_write(doc, 0, &json_len);
+	json = yyjson_mut_write_opts(doc, 0, &ctx->json_alc, &json_len, NULL);
 	if (!json) {
 		goto oom;
 	}
@@ -999,14 +1822,28 @@ int lws_post_error (lws_ctx_t *ctx, const char *error_message) {
 	}
 
 	/* post error */
-	lws_curl_reset(ctx);
-	curl_easy_setopt(ctx->curl, CURLOPT_POST, 1L);
-	curl_easy_setopt(ctx->curl, CURLOPT_URL, error_url);
-	curl_easy_setopt(ctx->curl, CURLOPT_HTTPHEADER, curl_headers);
-	curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDS, json);
-	curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)json_len);
-	if (lws_curl_perform(ctx, LWS_CURL_INITIATE | LWS_CURL_FINALIZE) != 0) {
-		goto cleanup;
+	if (ctx->client) {
+		iov[0].iov_base = json;
+		iov[0].iov_len = json_len;
+		if (lws_client_post(ctx, ctx->request_id ? LWS_CLIENT_ERROR : LWS_CLIENT_INIT_ERROR,
+				LWS_JSON_CT "\r\n", iov, 1) != 0) {
+			goto cleanup;
+		}
+	} else {
+		curl_headers = curl_slist_append(curl_headers, LWS_JSON_CT);
+		if (!curl_headers) {
+			goto oom;
+		}
+		lws_curl_reset(ctx->curl);
+		curl_easy_setopt(ctx->curl, CURLOPT_POST, 1L);
+		curl_easy_setopt(ctx->curl, CURLOPT_URL, error_url);
+		curl_easy_setopt(ctx->curl, CURLOPT_HTTPHEADER, curl_headers);
+		curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDS, json);
+		curl_easy_setopt(ctx->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)json_len);
+		if ((ctx->curl_next && ctx->request_id ? lws_curl_overlap(ctx)
+				: lws_curl_perform(ctx, LWS_CURL_INITIATE | LWS_CURL_FINALIZE)) != 0) {
+			goto cleanup;
+		}
 	}
 
 	/* successfully posted error */
@@ -1023,20 +1860,5 @@ int lws_post_error (lws_ctx_t *ctx, const char *error_message) {
 	if (doc) {
 		yyjson_mut_doc_free(doc);
 	}
-	if (json) {
-		lws_free(json);
-	}
 	return rc;
 }
-
-int lws_cancel_poll () {
-	if (!in_poll || curl_socket == CURL_SOCKET_BAD) {
-		return -1;
-	}
-	cancel_poll = 1;
-	if (close(curl_socket) != 0) {
-		return -1;
-	}
-	curl_socket = CURL_SOCKET_BAD;
-	return 0;
-}
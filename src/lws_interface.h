@@ -12,11 +12,18 @@
 #include <lws_runtime.h>
 
 
+#define LWS_USERAGENT               "lambda-lws/0.9"
+#define LWS_LAMBDA_RUNTIME_VERSION  "2018-06-01"
+
+
 int lws_get_next_invocation(lws_ctx_t *ctx);
 int lws_post_response(lws_ctx_t *ctx);
 int lws_stream_response(lws_ctx_t *ctx, int finalize);
+int lws_pull_response(lws_ctx_t *ctx, lws_producer_pt producer, void *userdata);
+int lws_upload_response(lws_ctx_t *ctx);
+void lws_abort_upload(lws_ctx_t *ctx);
+void lws_stop_sender(lws_ctx_t *ctx);
 int lws_post_error(lws_ctx_t *ctx, const char *error_message);
-int lws_cancel_poll(void);
 
 
 #endif /* _LWS_INTERFACE_INCLUDED */
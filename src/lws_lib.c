@@ -11,6 +11,8 @@
 #include <lws_log.h>
 #include <lws_interface.h>
 #include <lws_http.h>
+#include <lws_compress.h>
+#include <lws_envelope.h>
 
 #if LUA_VERSION_NUM < 503
 #define LUA_MAXINTEGER  PTRDIFF_MAX
@@ -76,6 +78,9 @@ static int lws_lua_yyjson_obj_iter_tostring(lua_State *L);
 static int lws_lua_response_index(lua_State *L);
 static int lws_lua_response_newindex(lua_State *L);
 
+/* raw request */
+static int lws_lua_raw_index(lua_State *L);
+
 /* strict */
 static int lws_lua_strict_index(lua_State *L);
 
@@ -84,6 +89,8 @@ static luaL_Stream *lws_create_file(lua_State *L);
 static int lws_close_file(lua_State *L);
 static int lws_file_read_hook(lua_State *L);
 static int lws_file_flush_hook(lua_State *L);
+static int lws_file_produce(void *userdata, lws_str_t *chunk);
+static int lws_file_stream(lua_State *L);
 static int lws_hook_file(lua_State *L);
 
 /* functions */
@@ -304,20 +311,24 @@ static int lws_lua_table_newindex (lua_State *L) {
 	lws_lua_table_t  *lt;
 
 	lt = luaL_checkudata(L, 1, LWS_TABLE);
-	if (lt->readonly) {
+	if (lt->readonly || (lt->seal && lt->seal->streaming)) {
 		return luaL_error(L, "table is read-only");
 	}
 	key.data = (char *)luaL_checklstring(L, 2, &key.len);
 	value.data = (char *)luaL_checklstring(L, 3, &value.len);
-	dup = lws_alloc(sizeof(lws_str_t) + value.len);
+	if (value.len > SIZE_MAX - sizeof(lws_str_t) - key.len) {
+		return luaL_error(L, "string too large");
+	}
+	dup = lws_arena_alloc(lt->arena, sizeof(lws_str_t) + value.len + key.len);
 	if (!dup) {
 		return luaL_error(L, "failed to allocate string");
 	}
 	dup->data = (char *)dup + sizeof(lws_str_t);
 	memcpy(dup->data, value.data, value.len);
 	dup->len = value.len;
+	memcpy(dup->data + value.len, key.data, key.len);  /* referenced by the table if new */
+	key.data = dup->data + value.len;
 	if (lws_table_set(lt->t, &key, dup) != 0) {
-		lws_free(dup);
 		return luaL_error(L, "failed to set table value");
 	}
 	return 0;
@@ -586,7 +597,7 @@ static int lws_lua_response_newindex (lua_State *L) {
 		if (lws_strncmp(key.data, "status", 6) == 0) {
 			status = luaL_checkinteger(L, 3);
 			lctx = lws_get_lua_request_ctx(L);
-			if (lctx->sealed) {
+			if (lctx->sealed || lctx->ctx->streaming) {
 				return luaL_error(L, "response header sealed");
 			}
 			lctx->ctx->resp_status = status;
@@ -603,6 +614,30 @@ static int lws_lua_response_newindex (lua_State *L) {
  * strict
  */
 
+static int lws_lua_raw_index (lua_State *L) {
+	lws_str_t               key;
+	yyjson_doc             *doc;
+	lws_lua_request_ctx_t  *lctx;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	key.data = (char *)luaL_checklstring(L, 2, &key.len);
+	if (key.len == 4 && lws_strncmp(key.data, "body", 4) == 0) {
+		/* parse on first access and cache */
+		lctx = lws_get_lua_request_ctx(L);
+		doc = lws_envelope_doc(lctx->ctx);
+		if (!doc) {
+			return luaL_error(L, "failed to parse request");
+		}
+		lws_lua_yyjson_push_val(L, yyjson_doc_get_root(doc));
+		lua_pushvalue(L, 2);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, 1);
+		return 1;
+	}
+	lua_rawget(L, 1);
+	return 1;
+}
+
 static int lws_lua_strict_index (lua_State *L) {
 	luaL_checktype(L, 1, LUA_TTABLE);
 	lua_rawget(L, 1);
@@ -655,6 +690,9 @@ static int lws_file_read_hook (lua_State *L) {
 	if (s->f != lctx->ctx->req_body_file) {
 		goto prev;
 	}
+	if (lws_envelope_body(lctx->ctx) != 0) {
+		goto prev;  /* the file read reports the error */
+	}
 #if LUA_VERSION_NUM >= 505
 	lua_pushexternalstring(L, lctx->ctx->req_body.data, lctx->ctx->req_body.len, NULL, NULL);
 #else
@@ -693,6 +731,67 @@ static int lws_file_flush_hook (lua_State *L) {
 	return lua_gettop(L);
 }
 
+static int lws_file_produce (void *userdata, lws_str_t *chunk) {
+	lua_State           *L;
+	lws_lua_producer_t  *p;
+
+	/* call the producer; errors must not unwind through the transport */
+	p = userdata;
+	L = p->L;
+	lua_pushvalue(L, 2);
+	if (lua_pcall(L, 0, 1, 0) != LUA_OK) {
+		goto error;
+	}
+
+	/* end of data? */
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		return 1;
+	}
+
+	/* chunk; anchored at index 3 while it is sent */
+	if (!lua_isstring(L, -1)) {
+		lua_pushfstring(L, "bad producer result (string or nil expected, got %s)",
+				luaL_typename(L, -1));
+		lua_remove(L, -2);
+		goto error;
+	}
+	chunk->data = (char *)lua_tolstring(L, -1, &chunk->len);
+	lua_replace(L, 3);
+	return 0;
+
+	error:
+	lua_replace(L, 3);
+	p->failed = 1;
+	return -1;
+}
+
+static int lws_file_stream (lua_State *L) {
+	luaL_Stream            *s;
+	lws_lua_producer_t      p;
+	lws_lua_request_ctx_t  *lctx;
+
+	s = luaL_checkudata(L, 1, LUA_FILEHANDLE);
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	lctx = lws_get_lua_request_ctx(L);
+	if (s->f != lctx->ctx->resp_body_file) {
+		return luaL_argerror(L, 1, "response body expected");
+	}
+	lua_settop(L, 2);
+	lua_pushnil(L);  /* [file, producer, chunk] */
+	lctx->sealed = 1;
+	lctx->response_headers->readonly = 1;
+	p.L = L;
+	p.failed = 0;
+	if (lws_pull_response(lctx->ctx, lws_file_produce, &p) != 0) {
+		if (p.failed) {
+			return lua_error(L);  /* error message at index 3 */
+		}
+		return luaL_error(L, "failed to stream response");
+	}
+	return 0;
+}
+
 static int lws_hook_file (lua_State *L) {
 	if (lws_getmetatable(L, LUA_FILEHANDLE) != LUA_TTABLE) {
 		return luaL_error(L, "no file metatable");
@@ -705,6 +804,8 @@ static int lws_hook_file (lua_State *L) {
 	}
 	lua_pushcclosure(L, lws_file_read_hook, 1);
 	lua_setfield(L, -2, "read");
+	lua_pushcfunction(L, lws_file_stream);
+	lua_setfield(L, -2, "stream");
 	if (lws_getfield(L, -1, "flush") != LUA_TFUNCTION) {
 		lws_log_debug("no file flush function");
 		lua_pop(L, 3);
@@ -946,6 +1047,12 @@ int lws_open_lws (lua_State *L) {
 	lua_setfield(L, -2, "__newindex");
 	lua_pop(L, 1);
 
+	/* raw request */
+	luaL_newmetatable(L, LWS_RAW);
+	lua_pushcfunction(L, lws_lua_raw_index);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
 	/* hook file */
 	lws_hook_file(L);
 
@@ -1046,8 +1153,8 @@ static void lws_push_env (lws_lua_request_ctx_t *lctx) {
 	lt->readonly = 1;  /* not strictly required, but consistent with req_headers */
 	lt->external = 1;  /* see request headers above */
 	lua_setfield(L, -2, "headers");
-	lws_lua_yyjson_push_val(L, yyjson_doc_get_root(ctx->doc));
-	lua_setfield(L, -2, "body");
+	luaL_getmetatable(L, LWS_RAW);  /* body is parsed on first access */
+	lua_setmetatable(L, -2);
 	lua_setfield(L, -2, "raw");
 	lua_setfield(L, -2, "request");
 
@@ -1058,6 +1165,8 @@ static void lws_push_env (lws_lua_request_ctx_t *lctx) {
 	lctx->response_headers = lws_create_lua_table(L);
 	lctx->response_headers->t = ctx->resp_headers;
 	lctx->response_headers->external = 1;  /* see request above */
+	lctx->response_headers->seal = ctx;  /* streaming may start automatically */
+	lctx->response_headers->arena = ctx->arena;
 	lua_setfield(L, -2, "headers");
 	response_body = lws_create_file(L);
 	response_body->f = ctx->resp_body_file;
@@ -21,6 +21,7 @@
 #define LWS_YYJSON_OBJ           "lws.yyjson_obj"           /* yyjson object metatable */
 #define LWS_YYJSON_OBJ_ITER      "lws.yyjson_obj_iter"      /* yyjson object iterator metatable */
 #define LWS_RESPONSE             "lws.response"             /* response metatable */
+#define LWS_RAW                  "lws.raw"                  /* raw request metatable */
 #define LWS_CHUNKS               "lws.chunks"               /* loaded chunks */
 #define LWS_FILE                 "lws.file"                 /* file environment (Lua 5.1) */
 
@@ -29,6 +30,7 @@ typedef struct lws_lua_request_ctx_s lws_lua_request_ctx_t;
 typedef struct lws_lua_table_s lws_lua_table_t;
 typedef struct lws_lua_yyjson_val_s lws_lua_yyjson_val_t;
 typedef struct lws_lua_yyjson_obj_iter_s lws_lua_yyjson_obj_iter_t;
+typedef struct lws_lua_producer_s lws_lua_producer_t;
 
 typedef enum {
 	LWS_LC_INIT,
@@ -47,6 +49,8 @@ struct lws_lua_request_ctx_s {
 
 struct lws_lua_table_s {
 	lws_table_t  *t;           /* table */
+	lws_ctx_t    *seal;        /* read-only once streaming; NULL = n/a */
+	lws_arena_t  *arena;       /* arena for set keys and values */
 	unsigned      readonly:1;  /* read-only access */
 	unsigned      external:1;  /* managed externally */
 };
@@ -59,6 +63,11 @@ struct lws_lua_yyjson_obj_iter_s {
 	yyjson_obj_iter  iter;  /* yyjson object iterator */
 };
 
+struct lws_lua_producer_s {
+	lua_State  *L;          /* Lua state with the producer function at index 2 */
+	unsigned    failed:1;   /* producer failed; error message at index 3 */
+};
+
 
 void lws_get_msg(lua_State *L, int index, lws_str_t *msg);
 int lws_traceback(lua_State *L);
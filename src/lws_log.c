@@ -13,6 +13,7 @@
 
 
 #define LWS_LOG_LEVEL(lit)  { lit, sizeof(lit) - 1 }
+#define LWS_LOG_POOL        16384  /* bounds the document and the escaped output */
 
 
 lws_str_t lws_log_levels[] = {
@@ -35,13 +36,14 @@ void lws_log_setctx (lws_ctx_t *c) {
 
 void lws_log (lws_log_level_e level, const char *fmt, ...) {
 	int              res;;
-	char             ts[20], tsm[25], msg[1024];
+	char             ts[20], tsm[25], msg[1024], pool[LWS_LOG_POOL];
 	size_t           tsm_len, msg_len;
 	va_list          ap;
 	struct tm        tm;
 	struct timeval   tv;
 	yyjson_mut_doc  *doc;
 	yyjson_mut_val  *root;
+	yyjson_alc       alc;
 
 	/* log? */
 	if (!ctx || level > ctx->log_level) {
@@ -75,8 +77,11 @@ void lws_log (lws_log_level_e level, const char *fmt, ...) {
 	/* handle JSON and text mode */
 	doc = NULL;
 	if (!ctx->log_text) {
-		/* JSON mode */
-		doc = yyjson_mut_doc_new(NULL);
+		/* JSON mode; allocated from the stack as logging may be concurrent */
+		if (!yyjson_alc_pool_init(&alc, pool, sizeof(pool))) {
+			goto textmode;
+		}
+		doc = yyjson_mut_doc_new(&alc);
 		if (!doc) {
 			goto textmode;
 		}
@@ -109,7 +114,7 @@ void lws_log (lws_log_level_e level, const char *fmt, ...) {
 
 		/* output log line */
 		flockfile(stdout);
-		if (!yyjson_mut_write_fp(stdout, doc, 0, NULL, NULL)) {
+		if (!yyjson_mut_write_fp(stdout, doc, 0, &alc, NULL)) {
 			yyjson_mut_doc_free(doc);
 			funlockfile(stdout);
 			goto textmode;
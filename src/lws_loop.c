@@ -0,0 +1,256 @@
+/*
+ * LWS event loop
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <lws_runtime.h>
+#include <lws_log.h>
+#include <lws_loop.h>
+
+
+static int lws_loop_socket(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp);
+static int lws_loop_timer(CURLM *multi, long timeout_ms, void *userp);
+
+
+/*
+ * libcurl
+ */
+
+static int lws_loop_socket (CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+	int                 op;
+	lws_loop_t         *loop;
+	struct epoll_event  ev;
+
+	/* remove; the socket may already be closed */
+	loop = userp;
+	if (what == CURL_POLL_REMOVE) {
+		if (socketp) {
+			epoll_ctl(loop->epfd, EPOLL_CTL_DEL, s, NULL);
+		}
+		return 0;
+	}
+
+	/* add or modify */
+	lws_memzero(&ev, sizeof(ev));
+	ev.events = (what & CURL_POLL_IN ? EPOLLIN : 0) | (what & CURL_POLL_OUT ? EPOLLOUT : 0);
+	ev.data.fd = s;
+	op = socketp ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	if (epoll_ctl(loop->epfd, op, s, &ev) != 0) {
+		if (op != EPOLL_CTL_ADD || errno != EEXIST
+				|| epoll_ctl(loop->epfd, EPOLL_CTL_MOD, s, &ev) != 0) {
+			lws_log(LWS_LOG_CRIT, "failed to register socket fd:%d: %s", s, strerror(errno));
+			return -1;
+		}
+	}
+	if (!socketp) {
+		curl_multi_assign(loop->curlm, s, loop);
+	}
+	return 0;
+}
+
+static int lws_loop_timer (CURLM *multi, long timeout_ms, void *userp) {
+	lws_loop_t  *loop;
+
+	loop = userp;
+	loop->deadline = timeout_ms < 0 ? -1 : lws_loop_now() + timeout_ms;
+	return 0;
+}
+
+
+/*
+ * loop
+ */
+
+int64_t lws_loop_now (void) {
+	struct timespec  ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+lws_loop_t *lws_loop_create (void) {
+	lws_loop_t          *loop;
+	struct epoll_event   ev;
+
+	loop = lws_calloc(sizeof(lws_loop_t));
+	if (!loop) {
+		return NULL;
+	}
+	loop->wakefd = -1;
+	loop->deadline = -1;
+	loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->epfd < 0) {
+		lws_log(LWS_LOG_EMERG, "failed to create epoll instance: %s", strerror(errno));
+		goto error;
+	}
+	loop->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (loop->wakefd < 0) {
+		lws_log(LWS_LOG_EMERG, "failed to create eventfd: %s", strerror(errno));
+		goto error;
+	}
+	lws_memzero(&ev, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = loop->wakefd;
+	if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev) != 0) {
+		lws_log(LWS_LOG_EMERG, "failed to register eventfd: %s", strerror(errno));
+		goto error;
+	}
+	return loop;
+
+	error:
+	lws_loop_free(loop);
+	return NULL;
+}
+
+void lws_loop_free (lws_loop_t *loop) {
+	if (loop->wakefd >= 0) {
+		close(loop->wakefd);
+	}
+	if (loop->epfd >= 0) {
+		close(loop->epfd);
+	}
+	lws_free(loop);
+}
+
+int lws_loop_attach (lws_loop_t *loop, CURLM *curlm) {
+	loop->curlm = curlm;
+	if (curl_multi_setopt(curlm, CURLMOPT_SOCKETFUNCTION, lws_loop_socket) != CURLM_OK
+			|| curl_multi_setopt(curlm, CURLMOPT_SOCKETDATA, loop) != CURLM_OK
+			|| curl_multi_setopt(curlm, CURLMOPT_TIMERFUNCTION, lws_loop_timer) != CURLM_OK
+			|| curl_multi_setopt(curlm, CURLMOPT_TIMERDATA, loop) != CURLM_OK) {
+		lws_log(LWS_LOG_EMERG, "failed to attach libcurl multi handle");
+		return -1;
+	}
+	return 0;
+}
+
+int lws_loop_add (lws_loop_t *loop, int fd, uint32_t events) {
+	struct epoll_event  ev;
+
+	/* registration ends when the descriptor is closed */
+	lws_memzero(&ev, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		lws_log(LWS_LOG_CRIT, "failed to register fd:%d: %s", fd, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+void lws_loop_set_idle (lws_loop_t *loop, lws_loop_idle_pt idle, void *userdata) {
+	loop->idle = idle;
+	loop->idle_data = userdata;
+}
+
+int lws_loop_wait (lws_loop_t *loop, int cancellable) {
+	int                 n, i, fd, mask, timeout, woken;
+	int64_t             now;
+	uint64_t            v;
+	CURLMcode           mres;
+	struct epoll_event  events[LWS_LOOP_EVENTS];
+
+	/* stopped? */
+	if (cancellable && loop->stop) {
+		return LWS_LOOP_STOPPED;
+	}
+
+	/* determine timeout from the libcurl timer; run idle work before blocking */
+	if (loop->deadline >= 0) {
+		now = lws_loop_now();
+		timeout = loop->deadline > now ? (int)(loop->deadline - now) : 0;
+	} else {
+		timeout = -1;
+	}
+	if (timeout != 0 && loop->idle) {
+		loop->idle(loop->idle_data);
+	}
+
+	/* wait for events */
+	n = epoll_wait(loop->epfd, events, LWS_LOOP_EVENTS, timeout);
+	if (n < 0) {
+		if (errno == EINTR) {
+			return 0;  /* the signal handler has written to the eventfd */
+		}
+		lws_log(LWS_LOG_CRIT, "failed to wait for events: %s", strerror(errno));
+		return -1;
+	}
+
+	/* dispatch events */
+	woken = 0;
+	for (i = 0; i < n; i++) {
+		fd = events[i].data.fd;
+		if (fd == loop->wakefd) {
+			if (read(loop->wakefd, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+				lws_log(LWS_LOG_CRIT, "failed to read eventfd: %s", strerror(errno));
+				return -1;
+			}
+			woken = 1;
+			continue;
+		}
+		if (!loop->curlm) {
+			continue;  /* native client; the caller retries its operation */
+		}
+		mask = 0;
+		if (events[i].events & EPOLLIN) {
+			mask |= CURL_CSELECT_IN;
+		}
+		if (events[i].events & EPOLLOUT) {
+			mask |= CURL_CSELECT_OUT;
+		}
+		if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+			mask |= CURL_CSELECT_ERR;
+		}
+		mres = curl_multi_socket_action(loop->curlm, fd, mask, &loop->running);
+		if (mres != CURLM_OK) {
+			lws_log(LWS_LOG_CRIT, "libcurl multi error code:%d str:%s", mres,
+					curl_multi_strerror(mres));
+			return -1;
+		}
+	}
+
+	/* expire the libcurl timer */
+	if (loop->curlm && loop->deadline >= 0 && lws_loop_now() >= loop->deadline) {
+		loop->deadline = -1;
+		mres = curl_multi_socket_action(loop->curlm, CURL_SOCKET_TIMEOUT, 0, &loop->running);
+		if (mres != CURLM_OK) {
+			lws_log(LWS_LOG_CRIT, "libcurl multi error code:%d str:%s", mres,
+					curl_multi_strerror(mres));
+			return -1;
+		}
+	}
+
+	/* handle wakeups */
+	if (woken) {
+		if (cancellable && loop->stop) {
+			return LWS_LOOP_STOPPED;
+		}
+		if (loop->idle) {
+			loop->idle(loop->idle_data);
+		}
+	}
+
+	return 0;
+}
+
+int lws_loop_wake (lws_loop_t *loop) {
+	uint64_t  v;
+
+	/* async-signal-safe */
+	v = 1;
+	return write(loop->wakefd, &v, sizeof(v)) == sizeof(v) ? 0 : -1;
+}
+
+int lws_loop_stop (lws_loop_t *loop) {
+	/* async-signal-safe */
+	loop->stop = 1;
+	return lws_loop_wake(loop);
+}
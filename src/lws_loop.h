@@ -0,0 +1,52 @@
+/*
+ * LWS event loop
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#ifndef _LWS_LOOP_INCLUDED
+#define _LWS_LOOP_INCLUDED
+
+
+#include <signal.h>
+#include <stdint.h>
+#include <curl/curl.h>
+
+
+#ifndef LWS_LOOP_EVENTS
+#define LWS_LOOP_EVENTS  16
+#endif
+
+#define LWS_LOOP_STOPPED  1  /* wait cancelled by stop */
+
+
+typedef struct lws_loop_s lws_loop_t;
+
+typedef void (*lws_loop_idle_pt)(void *userdata);
+
+
+struct lws_loop_s {
+	int                    epfd;       /* epoll instance */
+	int                    wakefd;     /* eventfd for stop and wakeups */
+	CURLM                 *curlm;      /* attached libcurl multi handle; NULL = native client */
+	int64_t                deadline;   /* libcurl timer deadline [ms]; -1 = none */
+	int                    running;    /* running libcurl transfers */
+	lws_loop_idle_pt       idle;       /* idle hook */
+	void                  *idle_data;  /* idle hook user data */
+	volatile sig_atomic_t  stop;       /* stop requested */
+};
+
+
+int64_t lws_loop_now(void);
+lws_loop_t *lws_loop_create(void);
+void lws_loop_free(lws_loop_t *loop);
+int lws_loop_attach(lws_loop_t *loop, CURLM *curlm);
+int lws_loop_add(lws_loop_t *loop, int fd, uint32_t events);
+void lws_loop_set_idle(lws_loop_t *loop, lws_loop_idle_pt idle, void *userdata);
+int lws_loop_wait(lws_loop_t *loop, int cancellable);
+int lws_loop_wake(lws_loop_t *loop);
+int lws_loop_stop(lws_loop_t *loop);
+
+
+#endif /* _LWS_LOOP_INCLUDED */
@@ -31,6 +31,9 @@ SUCH DAMAGE.
 #include <lws_runtime.h>
 #include <lws_ngx.h>
 #include <lws_log.h>
+#if LWS_PROFILE
+#include <malloc.h>
+#endif
 
 
 #ifndef __has_builtin
@@ -49,6 +52,9 @@ void *lws_alloc (size_t size) {
 		lws_log(LWS_LOG_CRIT, "failed to allocate memory size:%zu", size);
 		return NULL;
 	}
+#if LWS_PROFILE
+	lws_profile_alloc(p);
+#endif
 	return p;
 }
 
@@ -61,14 +67,22 @@ void *lws_calloc (size_t size) {
 		return NULL;
 	}
 	memset(p, 0, size);
+#if LWS_PROFILE
+	lws_profile_alloc(p);
+#endif
 	return p;
 }
 
 void *lws_realloc (void *p, size_t size) {
-	void  *new_p;
+	void    *new_p;
+#if LWS_PROFILE
+	size_t   old_size;
+
+	old_size = p ? malloc_usable_size(p) : 0;
+#endif
 
 	if (size == 0) {
-		free(p);
+		lws_free(p);
 		return NULL;
 	}
 	new_p = realloc(p, size);
@@ -76,9 +90,19 @@ void *lws_realloc (void *p, size_t size) {
 		lws_log(LWS_LOG_CRIT, "failed to allocate memory size:%zu", size);
 		return NULL;
 	}
+#if LWS_PROFILE
+	lws_profile_realloc(old_size, new_p, p && new_p != p);
+#endif
 	return new_p;
 }
 
+#if LWS_PROFILE
+void lws_free (void *p) {
+	lws_profile_free(p);
+	free(p);
+}
+#endif
+
 lws_int_t lws_strncasecmp (char *s1, char *s2, size_t n) {
 	lws_uint_t  c1, c2;
 
@@ -36,13 +36,18 @@ SUCH DAMAGE.
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <lws_profile.h>
 
 
 typedef intptr_t   lws_int_t;
 typedef uintptr_t  lws_uint_t;
 
 
+#if LWS_PROFILE
+void lws_free(void *p);
+#else
 #define lws_free(p)          free(p)
+#endif
 #define lws_memzero(buf, n)  (void)memset(buf, 0, n)
 
 void *lws_alloc(size_t size);
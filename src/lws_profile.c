@@ -0,0 +1,113 @@
+/*
+ * LWS allocation profile
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#include <malloc.h>
+#include <lws_log.h>
+#include <lws_profile.h>
+
+
+#if LWS_PROFILE
+
+
+#define lws_profile_add(var, n)  __atomic_fetch_add(&(var), n, __ATOMIC_RELAXED)
+
+
+typedef struct lws_profile_s lws_profile_t;
+
+struct lws_profile_s {
+	size_t   count;  /* allocations */
+	size_t   bytes;  /* allocated bytes */
+	size_t   copy;   /* bytes copied by moving reallocations */
+	int64_t  peak;   /* peak live bytes */
+};
+
+
+static void lws_profile_peak(lws_profile_t *p, int64_t live);
+
+static const char *lws_phases[] = { "fetch", "parse", "prepare", "lua", "serialize", "post" };
+static lws_profile_t lws_profiles[LWS_PHASE_MAX];
+static lws_phase_e lws_phase = LWS_PHASE_FETCH;
+static int64_t lws_live = 0;
+
+
+static void lws_profile_peak (lws_profile_t *p, int64_t live) {
+	/* approximate under concurrent allocation by the sender thread */
+	if (live > __atomic_load_n(&p->peak, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&p->peak, live, __ATOMIC_RELAXED);
+	}
+}
+
+void lws_profile_set_phase (lws_phase_e phase) {
+	__atomic_store_n(&lws_phase, phase, __ATOMIC_RELAXED);
+}
+
+void lws_profile_alloc (void *p) {
+	size_t          size;
+	lws_profile_t  *prof;
+
+	if (!p) {
+		return;
+	}
+	size = malloc_usable_size(p);
+	prof = &lws_profiles[__atomic_load_n(&lws_phase, __ATOMIC_RELAXED)];
+	lws_profile_add(prof->count, 1);
+	lws_profile_add(prof->bytes, size);
+	lws_profile_peak(prof, lws_profile_add(lws_live, (int64_t)size) + (int64_t)size);
+}
+
+void lws_profile_realloc (size_t old_size, void *p, int moved) {
+	size_t          size;
+	lws_profile_t  *prof;
+
+	if (!p) {
+		return;
+	}
+	size = malloc_usable_size(p);
+	prof = &lws_profiles[__atomic_load_n(&lws_phase, __ATOMIC_RELAXED)];
+	lws_profile_add(prof->count, 1);
+	lws_profile_add(prof->bytes, size);
+	if (moved) {
+		lws_profile_add(prof->copy, old_size < size ? old_size : size);
+	}
+	lws_profile_peak(prof, lws_profile_add(lws_live, (int64_t)size - (int64_t)old_size)
+			+ (int64_t)size - (int64_t)old_size);
+}
+
+void lws_profile_free (void *p) {
+	if (p) {
+		lws_profile_add(lws_live, -(int64_t)malloc_usable_size(p));
+	}
+}
+
+void lws_profile_report (long requests) {
+	int             i, n;
+	char            buf[768];
+	size_t          len;
+	int64_t         live;
+	lws_profile_t  *prof;
+
+	/* one line; phase counters restart, peaks restart at the live bytes */
+	live = __atomic_load_n(&lws_live, __ATOMIC_RELAXED);
+	len = 0;
+	for (i = 0; i < LWS_PHASE_MAX; i++) {
+		prof = &lws_profiles[i];
+		n = snprintf(buf + len, sizeof(buf) - len, " %s:%zu/%zu/%zu/%lld", lws_phases[i],
+				__atomic_exchange_n(&prof->count, 0, __ATOMIC_RELAXED),
+				__atomic_exchange_n(&prof->bytes, 0, __ATOMIC_RELAXED),
+				__atomic_exchange_n(&prof->copy, 0, __ATOMIC_RELAXED),
+				(long long)__atomic_exchange_n(&prof->peak, live, __ATOMIC_RELAXED));
+		if (n < 0 || (size_t)n >= sizeof(buf) - len) {
+			break;
+		}
+		len += (size_t)n;
+	}
+	lws_log(LWS_LOG_INFO, "alloc profile requests:%ld live:%lld phase:count/bytes/copy/peak%.*s",
+			requests, (long long)live, (int)len, buf);
+}
+
+
+#endif /* LWS_PROFILE */
@@ -0,0 +1,44 @@
+/*
+ * LWS allocation profile
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#ifndef _LWS_PROFILE_INCLUDED
+#define _LWS_PROFILE_INCLUDED
+
+
+#ifndef LWS_PROFILE
+#define LWS_PROFILE  0
+#endif
+
+
+#include <stddef.h>
+
+
+typedef enum {
+	LWS_PHASE_FETCH,
+	LWS_PHASE_PARSE,
+	LWS_PHASE_PREPARE,
+	LWS_PHASE_LUA,
+	LWS_PHASE_SERIALIZE,
+	LWS_PHASE_POST,
+	LWS_PHASE_MAX
+} lws_phase_e;
+
+
+#if LWS_PROFILE
+#define lws_profile_phase(phase)  lws_profile_set_phase(phase)
+
+void lws_profile_set_phase(lws_phase_e phase);
+void lws_profile_alloc(void *p);
+void lws_profile_realloc(size_t old_size, void *p, int moved);
+void lws_profile_free(void *p);
+void lws_profile_report(long requests);
+#else
+#define lws_profile_phase(phase)
+#endif
+
+
+#endif /* _LWS_PROFILE_INCLUDED */
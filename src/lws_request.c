@@ -6,6 +6,7 @@
 
 
 #include <stdio.h>
+#include <errno.h>
 #include <sys/stat.h>
 #include <lws_runtime.h>
 #include <lws_log.h>
@@ -14,6 +15,8 @@
 #include <lws_state.h>
 #include <lws_http.h>
 #include <lws_codec.h>
+#include <lws_compress.h>
+#include <lws_envelope.h>
 
 
 typedef enum {
@@ -24,14 +27,25 @@ typedef enum {
 
 
 static lws_file_status_e lws_get_file_status(lws_ctx_t *ctx, lws_str_t *filename);
+static ssize_t lws_read_request_body(void *cookie, char *data, size_t len);
+static int lws_seek_request_body(void *cookie, off64_t *offset, int whence);
+static int lws_append_response_body(lws_ctx_t *ctx, const char *data, size_t len);
 static ssize_t lws_write_response_body(void *cookie, const char *data, size_t len);
 static int lws_seek_response_body(void *cookie, off64_t *offset, int whence);
-static int lws_string_sub(lws_str_t *dest, lws_str_t *tmpl, lws_str_t *src, regmatch_t *match);
+static int lws_string_sub(lws_arena_t *arena, lws_str_t *dest, lws_str_t *tmpl, lws_str_t *src,
+		regmatch_t *match);
 static int lws_prepare_request(lws_ctx_t *ctx);
 static int lws_prepare_response(lws_ctx_t *ctx);
 static int lws_finalize_response(lws_ctx_t *ctx);
 
 
+static cookie_io_functions_t request_body_io_functions = {
+	.read  = lws_read_request_body,
+	.write = NULL,
+	.seek  = lws_seek_request_body,
+	.close = NULL
+};
+
 static cookie_io_functions_t response_body_io_functions = {
 	.read  = NULL,
 	.write = lws_write_response_body,
@@ -56,15 +70,60 @@ static lws_file_status_e lws_get_file_status (lws_ctx_t *ctx, lws_str_t *filenam
 	return fs;
 }
 
-static ssize_t lws_write_response_body (void *cookie, const char *data, size_t len) {
-	char       *resp_body_new;
-	size_t      required, capacity;
+static ssize_t lws_read_request_body (void *cookie, char *data, size_t len) {
+	size_t      n;
 	lws_ctx_t  *ctx;
-	lws_str_t   key, *ct;
 
-	/* lock as needed */
+	/* decode on first read */
 	ctx = cookie;
-	
+	if (lws_envelope_body(ctx) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	n = ctx->req_body.len - ctx->req_body_pos;
+	if (n > len) {
+		n = len;
+	}
+	memcpy(data, ctx->req_body.data + ctx->req_body_pos, n);
+	ctx->req_body_pos += n;
+	return n;
+}
+
+static int lws_seek_request_body (void *cookie, off64_t *offset, int whence) {
+	off64_t     pos;
+	lws_ctx_t  *ctx;
+
+	ctx = cookie;
+	if (lws_envelope_body(ctx) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	switch (whence) {
+	case SEEK_SET:
+		pos = *offset;
+		break;
+	case SEEK_CUR:
+		pos = (off64_t)ctx->req_body_pos + *offset;
+		break;
+	case SEEK_END:
+		pos = (off64_t)ctx->req_body.len + *offset;
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+	if (pos < 0 || (size_t)pos > ctx->req_body.len) {
+		errno = EINVAL;
+		return -1;
+	}
+	ctx->req_body_pos = pos;
+	*offset = pos;
+	return 0;
+}
+
+static int lws_append_response_body (lws_ctx_t *ctx, const char *data, size_t len) {
+	size_t  required, capacity;
+
 	/* sanity checks */
 	if (len > SIZE_MAX - ctx->resp_body.len) {
 		lws_log(LWS_LOG_ERR, "response body too large");
@@ -72,23 +131,10 @@ static ssize_t lws_write_response_body (void *cookie, const char *data, size_t l
 	}
 
 	/* determine required space */
-	if (ctx->resp_body.len == 0) {
-		lws_str_set(&key, "Content-Type");
-		ct = lws_table_get(ctx->resp_headers, &key);
-		ctx->likely_utf8 = ct && ((ct->len >= 9 && lws_strncmp(ct->data, "text/html", 9) == 0)
-				|| (ct->len >= 10 && lws_strncmp(ct->data, "text/plain", 10) == 0)
-				|| (ct->len >= 16 && lws_strncmp(ct->data, "application/json", 16) == 0));
-	}
-	if (ctx->likely_utf8 || ctx->streaming) {
-		required = ctx->resp_body.len + len;
-	} else {
-		if (lws_base64_encode_len(ctx->resp_body.len + len, &required) != 0) {
-			required = ctx->resp_body.len + len;
-		}
-	}
+	required = ctx->resp_body.len + len;
 
-	/* allocate as needed */
-	capacity = ctx->resp_body_cap;
+	/* commit as needed; the body grows in place and is never copied */
+	capacity = ctx->resp_region.committed;
 	if (capacity < required) {
 		if (capacity == 0) {
 			capacity = 4096;
@@ -108,16 +154,106 @@ static ssize_t lws_write_response_body (void *cookie, const char *data, size_t l
 				}
 			}
 		}
-		resp_body_new = lws_realloc(ctx->resp_body.data, capacity);
-		if (!resp_body_new) {
+		if (ctx->streaming && ctx->stream_buffer && capacity > ctx->stream_buffer
+				&& required <= ctx->stream_buffer) {
+			capacity = ctx->stream_buffer;
+		}
+		if (capacity > ctx->resp_region.reserved) {
+			capacity = required;
+		}
+		if (lws_region_commit(&ctx->resp_region, capacity) != 0) {
 			return -1;
 		}
-		ctx->resp_body.data = resp_body_new;
-		ctx->resp_body_cap = capacity;
 	}
 	memcpy(ctx->resp_body.data + ctx->resp_body.len, data, len);
 	ctx->resp_body.len += len;
 
+	return 0;
+}
+
+static ssize_t lws_write_response_body (void *cookie, const char *data, size_t len) {
+	size_t      written, n;
+	int64_t     now;
+	lws_ctx_t  *ctx;
+
+	/* streaming */
+	ctx = cookie;
+	if (ctx->streaming) {
+		written = len;
+		now = ctx->stream_flush_ms ? lws_loop_now() : 0;
+		if (ctx->resp_body.len == 0) {
+			ctx->stream_pending = now;
+		}
+
+		/* bounded buffer: send buffered data whenever the buffer fills */
+		while (ctx->stream_buffer && ctx->resp_body.len + len > ctx->stream_buffer) {
+			n = ctx->resp_body.len < ctx->stream_buffer
+					? ctx->stream_buffer - ctx->resp_body.len : 0;
+			if (lws_append_response_body(ctx, data, n) != 0
+					|| lws_stream_response(ctx, 0) != 0) {
+				return -1;
+			}
+			if (ctx->resp_body.len >= ctx->stream_buffer) {
+				lws_log(LWS_LOG_ERR, "streaming buffer not drained");
+				return -1;
+			}
+			ctx->stream_pending = now;
+			data += n;
+			len -= n;
+		}
+		if (lws_append_response_body(ctx, data, len) != 0) {
+			return -1;
+		}
+
+		/* flush policy: buffered bytes and age of the oldest unsent data */
+		if ((ctx->stream_flush_bytes && ctx->resp_body.len >= ctx->stream_flush_bytes)
+				|| (ctx->stream_flush_ms && ctx->resp_body.len
+				&& now - ctx->stream_pending >= ctx->stream_flush_ms)) {
+			if (lws_stream_response(ctx, 0) != 0) {
+				return -1;
+			}
+		}
+
+		return written;
+	}
+
+	/* append */
+	if (lws_append_response_body(ctx, data, len) != 0) {
+		return -1;
+	}
+
+	/* track UTF-8 validity and the escaped length while the data is hot */
+	if (ctx->raw) {
+		return len;
+	}
+	ctx->resp_body_utf8 = lws_utf8_escape_update(ctx->resp_body_utf8,
+			(const uint8_t *)ctx->resp_body.data + ctx->resp_body_utf8_pos,
+			ctx->resp_body.len - ctx->resp_body_utf8_pos, &ctx->resp_body_escaped);
+	ctx->resp_body_utf8_pos = ctx->resp_body.len;
+
+	/* automatic streaming of binary or large bodies, avoiding base64 and the payload limit */
+	if (ctx->auto_stream && (ctx->resp_body_utf8 == LWS_UTF8_REJECT || (ctx->auto_stream_threshold
+			&& ctx->resp_body.len > ctx->auto_stream_threshold))) {
+		lws_log_debug("auto stream len:%zu utf8:%d", ctx->resp_body.len,
+				ctx->resp_body_utf8 != LWS_UTF8_REJECT);
+		if (lws_stream_response(ctx, 0) != 0) {
+			return -1;
+		}
+		return len;
+	}
+
+	/* progressive upload of valid UTF-8; binary before the upload takes the regular path */
+	if (ctx->progressive && !ctx->upload_skip) {
+		if (ctx->resp_body_utf8 == LWS_UTF8_REJECT) {
+			lws_abort_upload(ctx);
+		} else if (ctx->resp_body.len - ctx->resp_body_pos >= ctx->progressive) {
+			if (lws_upload_response(ctx) != 0) {
+				lws_log(LWS_LOG_WARN, "failed to upload response progressively");
+				lws_abort_upload(ctx);
+			}
+		}
+	}
+
 	return len;
 }
 
@@ -128,11 +264,20 @@ static int lws_seek_response_body (void *cookie, off64_t *offset, int whence) {
 	if (whence != SEEK_SET || *offset < 0 || (size_t)*offset > ctx->resp_body.len) {
 		return -1;
 	}
+	if (ctx->progressive && !ctx->streaming) {
+		lws_abort_upload(ctx);  /* the body may be rewritten */
+	}
+	if ((size_t)*offset < ctx->resp_body_utf8_pos) {
+		ctx->resp_body_utf8 = LWS_UTF8_ACCEPT;  /* revalidated with the next write */
+		ctx->resp_body_utf8_pos = 0;
+		ctx->resp_body_escaped = 0;
+	}
 	ctx->resp_body.len = (size_t)*offset;
 	return 0;
 }
 
-static int lws_string_sub (lws_str_t *dest, lws_str_t *tmpl, lws_str_t *src, regmatch_t *match) {
+static int lws_string_sub (lws_arena_t *arena, lws_str_t *dest, lws_str_t *tmpl, lws_str_t *src,
+		regmatch_t *match) {
 	int     d;
 	char   *p;
 	size_t  len, i, match_len;
@@ -162,7 +307,7 @@ static int lws_string_sub (lws_str_t *dest, lws_str_t *tmpl, lws_str_t *src, reg
 	}
 
 	/* allocate */
-	p = lws_alloc(len);
+	p = lws_arena_alloc(arena, len);
 	if (!p) {
 		return -1;
 	}
@@ -207,26 +352,23 @@ static int lws_prepare_request (lws_ctx_t *ctx) {
 	}
 
 	/* main */
-	if (lws_string_sub(&main, &ctx->main, &ctx->req_path, path_match) != 0) {
+	if (lws_string_sub(ctx->arena, &main, &ctx->main, &ctx->req_path, path_match) != 0) {
 		lws_log(LWS_LOG_ERR, "failed to substitute main path");
 		return -1;
 	}
 	if (ctx->task_root.len > SIZE_MAX - 1 || main.len >= SIZE_MAX - 1 - ctx->task_root.len) {
 		lws_log(LWS_LOG_ERR, "main path too long len:%zu", main.len);
-		lws_free(main.data);
 		return -1;
 	}
 	ctx->req_main.len = ctx->task_root.len + 1 + main.len;
-	ctx->req_main.data = lws_alloc(ctx->req_main.len + 1);
+	ctx->req_main.data = lws_arena_alloc(ctx->arena, ctx->req_main.len + 1);
 	if (!ctx->req_main.data) {
-		lws_free(main.data);
 		return -1;
 	}
 	memcpy(ctx->req_main.data, ctx->task_root.data, ctx->task_root.len);
 	ctx->req_main.data[ctx->task_root.len] = '/';
 	memcpy(ctx->req_main.data + ctx->task_root.len + 1, main.data, main.len);
 	ctx->req_main.data[ctx->req_main.len] = '\0';
-	lws_free(main.data);
 	lws_log_debug("main filename:%.*s", (int)ctx->req_main.len, ctx->req_main.data);
 	if (lws_get_file_status(ctx, &ctx->req_main) != LWS_FS_FOUND) {
 		return 404;  /* not found */
@@ -234,15 +376,22 @@ static int lws_prepare_request (lws_ctx_t *ctx) {
 
 	/* path info */
 	if (ctx->path_info.len) {
-		if (lws_string_sub(&ctx->req_path_info, &ctx->path_info, &ctx->req_path, path_match) != 0) {
+		if (lws_string_sub(ctx->arena, &ctx->req_path_info, &ctx->path_info, &ctx->req_path,
+				path_match) != 0) {
 			lws_log(LWS_LOG_ERR, "failed to substitute path info");
 			return -1;
 		}
 		lws_log_debug("path info:%.*s", (int)ctx->req_path_info.len, ctx->req_path_info.data);
 	}
 
-	/* body */
-	ctx->req_body_file = fmemopen(ctx->req_body.data, ctx->req_body.len, "rb");
+	/* body; an escaped or encoded body is decoded on first access */
+	lws_decompress_prepare(ctx);
+	if (ctx->req_body_escaped || ctx->req_body_base64
+			|| ctx->req_body_encoding != LWS_CE_IDENTITY) {
+		ctx->req_body_file = fopencookie(ctx, "rb", request_body_io_functions);
+	} else {
+		ctx->req_body_file = fmemopen(ctx->req_body.data, ctx->req_body.len, "rb");
+	}
 	if (!ctx->req_body_file) {
 		lws_log(LWS_LOG_CRIT, "failed to open request body file");
 		return -1;
@@ -271,7 +420,6 @@ static int lws_prepare_response (lws_ctx_t *ctx) {
 
 static int lws_finalize_response (lws_ctx_t *ctx) {
 	if (ctx->streaming) {
-		ctx->streaming_eof = 1;
 		if (lws_stream_response(ctx, 1) != 0) {
 			return -1;
 		}
@@ -282,12 +430,14 @@ static int lws_finalize_response (lws_ctx_t *ctx) {
 int lws_handle_request (lws_ctx_t *ctx) {
 	int  rc, rc_finalize;
 
+	lws_profile_phase(LWS_PHASE_PREPARE);
 	if ((rc = lws_prepare_response(ctx)) != 0) {
 		return rc;
 	}
 	if ((rc = lws_prepare_request(ctx)) != 0) {
 		return rc;
 	}
+	lws_profile_phase(LWS_PHASE_LUA);
 	if ((rc = lws_acquire_state(ctx)) != 0) {
 		return rc;
 	}
@@ -297,6 +447,7 @@ int lws_handle_request (lws_ctx_t *ctx) {
 		}
 	}
 	lws_release_state(ctx);
+	lws_profile_phase(LWS_PHASE_SERIALIZE);
 	if ((rc_finalize = lws_finalize_response(ctx)) != 0) {
 		rc = rc_finalize;
 	}
@@ -312,6 +463,7 @@ int lws_error_response (lws_ctx_t *ctx, int code) {
 	/* init state */
 	rc = -1;
 	doc = NULL;
+	lws_profile_phase(LWS_PHASE_SERIALIZE);
 
 	/* check response body file and truncate */
 	if (!ctx->resp_body_file) {
@@ -324,7 +476,7 @@ int lws_error_response (lws_ctx_t *ctx, int code) {
 	}
 
 	/* prepare error response */
-	doc = yyjson_mut_doc_new(NULL);
+	doc = yyjson_mut_doc_new(&ctx->json_alc);
 	if (!doc) {
 		goto oom;
 	}
@@ -358,7 +510,7 @@ int lws_error_response (lws_ctx_t *ctx, int code) {
 	}
 
 	/* write error response to response body file */
-	if (!yyjson_mut_write_fp(ctx->resp_body_file, doc, 0, NULL, NULL)) {
+	if (!yyjson_mut_write_fp(ctx->resp_body_file, doc, 0, &ctx->json_alc, NULL)) {
 		goto oom;
 	}
 
@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <limits.h>
 #include <lws_runtime.h>
+#include <lws_codec.h>
 #include <lws_interface.h>
 #include <lws_request.h>
 #include <lws_state.h>
@@ -23,8 +24,11 @@ static int lws_getenv_size(const char *name, size_t *value);
 static int lws_getenv_flag(const char *name, int *value);
 static int lws_getenv_enum(const char *name, unsigned int *value, lws_str_t *options,
 		const char *dfl);
+static size_t lws_high_water(size_t *high, size_t used);
+static void lws_retain_buffer(lws_str_t *buf, size_t *cap, size_t *high, size_t used);
 
 static volatile sig_atomic_t keep_running = 1;
+static lws_loop_t *volatile term_loop = NULL;
 
 
 /*
@@ -32,8 +36,10 @@ static volatile sig_atomic_t keep_running = 1;
  */
 
 static void lws_handle_sigterm (int sig) {
-	(void)lws_cancel_poll();
 	keep_running = 0;
+	if (term_loop) {
+		(void)lws_loop_stop(term_loop);  /* cancels polling for the next invocation */
+	}
 }
 
 static void lws_getenv_str (const char *name, lws_str_t *value) {
@@ -145,8 +151,37 @@ static int lws_getenv_enum (const char *name, unsigned int *value, lws_str_t *op
 	return -1;
 }
 
+static size_t lws_high_water (size_t *high, size_t used) {
+	/* track a decaying high-water mark; buffers well above it are shrunk */
+	*high -= *high / 8;
+	if (used > *high) {
+		*high = used;
+	}
+	return *high < 4096 ? 4096 : *high;
+}
+
+static void lws_retain_buffer (lws_str_t *buf, size_t *cap, size_t *high, size_t used) {
+	char    *data;
+	size_t   target;
+
+	target = lws_high_water(high, used);
+	if (buf->data && *cap / 2 > target) {
+		data = lws_realloc(buf->data, target);
+		if (data) {
+			buf->data = data;
+			*cap = target;
+		}
+	}
+	buf->len = 0;
+}
+
 int main (int argc, char *argv[]) {
-	int        rc, rc_request;
+	int        rc, rc_request, rc_client;
+	size_t     target;
+	lws_int_t  function_memory;
+#if LWS_PROFILE
+	lws_int_t  profile_count;
+#endif
 	lws_ctx_t  ctx;
 	lws_str_t  match;
 
@@ -159,9 +194,15 @@ int main (int argc, char *argv[]) {
 	/* setup signal handler */
 	signal(SIGTERM, lws_handle_sigterm);
 
+	/* select codec kernels */
+	lws_log_debug("codec kernels isa:%s", lws_codec_isa_name(lws_codec_init()));
+
 	/* init context */
 	lws_memzero(&ctx, sizeof(ctx));
 	ctx.content_length = -1;
+#if LWS_PROFILE
+	profile_count = 0;
+#endif
 
 	/* set log context */
 	lws_log_setctx(&ctx);
@@ -184,22 +225,69 @@ int main (int argc, char *argv[]) {
 	}
 	lws_log_debug("task root dir:%.*s", (int)ctx.task_root.len, ctx.task_root.data);
 
-	/* initialize libcurl */
-	if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0) {
-		lws_log(LWS_LOG_EMERG, "failed to initialize libcurl");
+	/* initialize the event loop */
+	ctx.loop = lws_loop_create();
+	if (!ctx.loop) {
 		rc = EXIT_FAILURE;
 		goto global_cleanup;
 	}
-	ctx.curl_global_init = 1;
-	ctx.curl = curl_easy_init();
-	if (!ctx.curl) {
-		lws_log(LWS_LOG_EMERG, "failed to create libcurl easy handle");
+	term_loop = ctx.loop;
+
+	/* initialize the request arenas; JSON is allocated from retained blocks */
+	ctx.arena = lws_arena_create(LWS_ARENA_SIZE);
+	ctx.doc_arena = lws_arena_create(LWS_ARENA_SIZE);
+	ctx.json_arena = lws_arena_create(LWS_ARENA_SIZE);
+	if (!ctx.arena || !ctx.doc_arena || !ctx.json_arena) {
+		lws_log(LWS_LOG_EMERG, "failed to create request arenas");
 		rc = EXIT_FAILURE;
 		goto global_cleanup;
 	}
-	ctx.curlm = curl_multi_init();
-	if (!ctx.curlm) {
-		lws_log(LWS_LOG_EMERG, "failed to create libcurl multi handle");
+	if (lws_region_reserve(&ctx.resp_region, LWS_RESP_RESERVE) != 0) {
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	ctx.resp_body.data = ctx.resp_region.data;
+	lws_arena_alc(ctx.doc_arena, &ctx.doc_alc);
+	lws_arena_alc(ctx.json_arena, &ctx.json_alc);
+
+	/* initialize the runtime API client; a bad value is reported through the default client */
+	rc_client = lws_getenv_enum("LWS_HTTP_CLIENT", &ctx.http_client, lws_http_clients, "curl");
+	if (rc_client != 0) {
+		ctx.http_client = LWS_HTTP_CLIENT_CURL;
+	}
+	if (ctx.http_client == LWS_HTTP_CLIENT_NATIVE) {
+		ctx.client = lws_client_create(&ctx.runtime_api, ctx.loop);
+		if (!ctx.client) {
+			lws_log(LWS_LOG_EMERG, "failed to create native runtime API client");
+			rc = EXIT_FAILURE;
+			goto global_cleanup;
+		}
+	} else {
+		if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0) {
+			lws_log(LWS_LOG_EMERG, "failed to initialize libcurl");
+			rc = EXIT_FAILURE;
+			goto global_cleanup;
+		}
+		ctx.curl_global_init = 1;
+		ctx.curl = curl_easy_init();
+		if (!ctx.curl) {
+			lws_log(LWS_LOG_EMERG, "failed to create libcurl easy handle");
+			rc = EXIT_FAILURE;
+			goto global_cleanup;
+		}
+		ctx.curlm = curl_multi_init();
+		if (!ctx.curlm) {
+			lws_log(LWS_LOG_EMERG, "failed to create libcurl multi handle");
+			rc = EXIT_FAILURE;
+			goto global_cleanup;
+		}
+		if (lws_loop_attach(ctx.loop, ctx.curlm) != 0) {
+			rc = EXIT_FAILURE;
+			goto global_cleanup;
+		}
+	}
+	if (rc_client != 0) {
+		lws_post_error(&ctx, "bad LWS_HTTP_CLIENT value");
 		rc = EXIT_FAILURE;
 		goto global_cleanup;
 	}
@@ -238,6 +326,26 @@ int main (int argc, char *argv[]) {
 		rc = EXIT_FAILURE;
 		goto global_cleanup;
 	}
+	if (lws_getenv_size("LWS_MEM_MAX", &ctx.state_mem_max) != 0) {
+		lws_post_error(&ctx, "bad LWS_MEM_MAX value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_size("LWS_TRIM", &ctx.state_trim) != 0) {
+		lws_post_error(&ctx, "bad LWS_TRIM value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_int("LWS_RSS_MAX", &ctx.state_rss) != 0 || ctx.state_rss < 0
+			|| ctx.state_rss > 100) {
+		lws_post_error(&ctx, "bad LWS_RSS_MAX value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_int("AWS_LAMBDA_FUNCTION_MEMORY_SIZE", &function_memory) == 0
+			&& function_memory > 0 && (size_t)function_memory <= SIZE_MAX / (1024 * 1024)) {
+		ctx.function_memory = (size_t)function_memory * 1024 * 1024;
+	}
 	if (lws_getenv_flag("LWS_DIAGNOSTIC", &ctx.state_diagnostic) != 0) {
 		lws_post_error(&ctx, "bad LWS_DIAGNOSTIC value");
 		rc = EXIT_FAILURE;
@@ -253,6 +361,97 @@ int main (int argc, char *argv[]) {
 		rc = EXIT_FAILURE;
 		goto global_cleanup;
 	}
+	if (lws_getenv_flag("LWS_OVERLAP", &ctx.overlap) != 0) {
+		lws_post_error(&ctx, "bad LWS_OVERLAP value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_size("LWS_PROGRESSIVE", &ctx.progressive) != 0) {
+		lws_post_error(&ctx, "bad LWS_PROGRESSIVE value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_size("LWS_STREAM_QUEUE", &ctx.stream_queue) != 0) {
+		lws_post_error(&ctx, "bad LWS_STREAM_QUEUE value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_size("LWS_STREAM_BUFFER", &ctx.stream_buffer) != 0) {
+		lws_post_error(&ctx, "bad LWS_STREAM_BUFFER value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_size("LWS_STREAM_FLUSH_BYTES", &ctx.stream_flush_bytes) != 0) {
+		lws_post_error(&ctx, "bad LWS_STREAM_FLUSH_BYTES value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_int("LWS_STREAM_FLUSH_MS", &ctx.stream_flush_ms) != 0
+			|| ctx.stream_flush_ms < 0) {
+		lws_post_error(&ctx, "bad LWS_STREAM_FLUSH_MS value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_int("LWS_STREAM_HEARTBEAT", &ctx.stream_heartbeat) != 0
+			|| ctx.stream_heartbeat < 0) {
+		lws_post_error(&ctx, "bad LWS_STREAM_HEARTBEAT value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_flag("LWS_AUTO_STREAM", &ctx.auto_stream) != 0) {
+		lws_post_error(&ctx, "bad LWS_AUTO_STREAM value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_size("LWS_AUTO_STREAM_THRESHOLD", &ctx.auto_stream_threshold) != 0) {
+		lws_post_error(&ctx, "bad LWS_AUTO_STREAM_THRESHOLD value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_flag("LWS_COMPRESS", &ctx.compress) != 0) {
+		lws_post_error(&ctx, "bad LWS_COMPRESS value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_int("LWS_COMPRESS_LEVEL", &ctx.compress_level) != 0
+			|| ctx.compress_level < 0 || ctx.compress_level > 9) {
+		lws_post_error(&ctx, "bad LWS_COMPRESS_LEVEL value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (lws_getenv_size("LWS_COMPRESS_MIN", &ctx.compress_min) != 0) {
+		lws_post_error(&ctx, "bad LWS_COMPRESS_MIN value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	lws_getenv_str("LWS_COMPRESS_TYPES", &ctx.compress_types);
+	if (!ctx.compress_types.len) {
+		lws_str_set(&ctx.compress_types, LWS_COMPRESS_TYPES_DEFAULT);
+	}
+	if (lws_getenv_int("LWS_DECOMPRESS", &ctx.decompress) != 0 || ctx.decompress < 0) {
+		lws_post_error(&ctx, "bad LWS_DECOMPRESS value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+#if LWS_PROFILE
+	if (lws_getenv_int("LWS_PROFILE_INTERVAL", &ctx.profile_interval) != 0
+			|| ctx.profile_interval < 0) {
+		lws_post_error(&ctx, "bad LWS_PROFILE_INTERVAL value");
+		rc = EXIT_FAILURE;
+		goto global_cleanup;
+	}
+	if (ctx.profile_interval == 0) {
+		ctx.profile_interval = 1;
+	}
+#endif
+	if (ctx.overlap && !ctx.client) {
+		ctx.curl_next = curl_easy_init();
+		if (!ctx.curl_next) {
+			lws_post_error(&ctx, "failed to create libcurl easy handle");
+			rc = EXIT_FAILURE;
+			goto global_cleanup;
+		}
+	}
 
 	/* initailize stat cache */
 	ctx.stat_cache = lws_table_create(32);
@@ -271,16 +470,13 @@ int main (int argc, char *argv[]) {
 		rc = EXIT_FAILURE;
 		goto global_cleanup;
 	}
-	lws_table_set_dup(ctx.headers, 1);
-	lws_table_set_free(ctx.headers, 1);
-	lws_table_set_ci(ctx.headers, 1);
+	lws_table_set_ci(ctx.headers, 1);  /* keys and values are in the arena or client buffers */
 	ctx.req_headers = lws_table_create(32);
 	if (!ctx.req_headers) {
 		lws_post_error(&ctx, "failed to create request headers table");
 		rc = EXIT_FAILURE;
 		goto global_cleanup;
 	}
-	lws_table_set_free(ctx.req_headers, 1);
 	lws_table_set_ci(ctx.req_headers, 1);
 	ctx.resp_headers = lws_table_create(32);
 	if (!ctx.resp_headers) {
@@ -288,13 +484,12 @@ int main (int argc, char *argv[]) {
 		rc = EXIT_FAILURE;
 		goto global_cleanup;
 	}
-	lws_table_set_dup(ctx.resp_headers, 1);
-	lws_table_set_free(ctx.resp_headers, 1);
 	lws_table_set_ci(ctx.resp_headers, 1);
 
 	/* request main loop */
 	while (keep_running && rc == EXIT_SUCCESS) {
 		/* get invocation */
+		lws_profile_phase(LWS_PHASE_FETCH);
 		if (lws_get_next_invocation(&ctx) != 0) {
 			if (keep_running) {
 				if (ctx.request_id) {
@@ -359,16 +554,15 @@ int main (int argc, char *argv[]) {
 		/* request cleanup */
 		request_cleanup:
 
+		/* streaming sender thread; normally joined by the final flush or the error post */
+		lws_stop_sender(&ctx);
+
 		/* Lambda request cleanup */
 		lws_table_clear(ctx.headers);
 		ctx.request_id = NULL;
 		ctx.content_length = -1;
-		if (ctx.body.data) {
-			lws_free(ctx.body.data);
-			ctx.body.data = NULL;
-			ctx.body.len = 0;
-			ctx.body_cap = 0;
-		}
+		lws_retain_buffer(&ctx.body, &ctx.body_cap, &ctx.body_high, ctx.body.len
+				+ YYJSON_PADDING_SIZE);
 		if (ctx.doc) {
 			yyjson_doc_free(ctx.doc);
 			ctx.doc = NULL;
@@ -379,14 +573,8 @@ int main (int argc, char *argv[]) {
 		lws_str_null(&ctx.req_path);
 		lws_str_null(&ctx.req_args);
 		lws_str_null(&ctx.req_ip);
-		if (ctx.req_main.data) {
-			lws_free(ctx.req_main.data);
-			lws_str_null(&ctx.req_main);
-		}
-		if (ctx.req_path_info.data) {
-			lws_free(ctx.req_path_info.data);
-			lws_str_null(&ctx.req_path_info);
-		}
+		lws_str_null(&ctx.req_main);
+		lws_str_null(&ctx.req_path_info);
 		lws_table_clear(ctx.req_headers);
 		if (ctx.req_body_file) {
 			if (fclose(ctx.req_body_file) != 0) {
@@ -394,7 +582,16 @@ int main (int argc, char *argv[]) {
 			}
 			ctx.req_body_file = NULL;
 		}
+		if (ctx.req_body_decoded) {
+			lws_free(ctx.req_body.data);
+			ctx.req_body_decoded = 0;
+		}
 		lws_str_null(&ctx.req_body);
+		ctx.req_body_escaped = 0;
+		ctx.req_body_base64 = 0;
+		ctx.req_body_encoding = LWS_CE_IDENTITY;
+		ctx.req_body_pos = 0;
+		ctx.req_body_failed = 0;
 
 		/* payload response cleanup */
 		lws_table_clear(ctx.resp_headers);
@@ -404,41 +601,77 @@ int main (int argc, char *argv[]) {
 			}
 			ctx.resp_body_file = NULL;
 		}
-		if (ctx.resp_body.data) {
-			lws_free(ctx.resp_body.data);
-			lws_str_null(&ctx.resp_body);
-			ctx.resp_body_pos = 0;
-			ctx.resp_body_cap = 0;
+		target = lws_high_water(&ctx.resp_body_high, ctx.resp_body.len);
+		if (ctx.resp_region.committed / 2 > target) {
+			lws_region_decommit(&ctx.resp_region, target);
 		}
-		if (ctx.diagnostic.data) {
-			lws_free(ctx.diagnostic.data);
-			lws_str_null(&ctx.diagnostic);
+		ctx.resp_body.len = 0;
+		ctx.resp_body_pos = 0;
+		lws_str_null(&ctx.diagnostic);
+		lws_str_null(&ctx.envelope);
+		ctx.envelope_pos = 0;
+		ctx.envelope_suffix_pos = 0;
+		lws_str_null(&ctx.streaming_prelude);
+		ctx.streaming_prelude_pos = 0;
+		if (ctx.compressor) {
+			lws_compress_free(ctx.compressor);
+			ctx.compressor = NULL;
 		}
-		if (ctx.streaming_prelude.data) {
-			lws_free(ctx.streaming_prelude.data);
-			lws_str_null(&ctx.streaming_prelude);
-			ctx.streaming_prelude_pos = 0;
-		}
-		ctx.likely_utf8 = 0;
+		ctx.envelope_base64 = 0;
+		ctx.resp_body_utf8 = LWS_UTF8_ACCEPT;
+		ctx.resp_body_utf8_pos = 0;
+		ctx.resp_body_escaped = 0;
+		ctx.uploading = 0;
+		ctx.upload_skip = 0;
+		ctx.upload_dropped = 0;
 		ctx.streaming = 0;
 		ctx.streaming_paused = 0;
 		ctx.streaming_eof = 0;
 		ctx.streaming_separator = 0;
+
+		/* release request-scoped allocations */
+		lws_arena_reset(ctx.arena);
+		lws_arena_reset(ctx.doc_arena);
+		lws_arena_reset(ctx.json_arena);
+
+		/* govern memory */
+		lws_govern_state(&ctx);
+
+#if LWS_PROFILE
+		/* report allocation profile */
+		if (++profile_count >= ctx.profile_interval) {
+			lws_profile_report((long)profile_count);
+			profile_count = 0;
+		}
+#endif
 	}
 
 	/* global cleanup */
 	global_cleanup:
 
-	/* cleanup libcurl */
+	/* cleanup runtime API client */
+	if (ctx.client) {
+		lws_client_free(ctx.client);
+	}
 	if (ctx.curl) {
 		curl_easy_cleanup(ctx.curl);
 	}
+	if (ctx.curl_next) {
+		if (ctx.next_pending) {
+			curl_multi_remove_handle(ctx.curlm, ctx.curl_next);
+		}
+		curl_easy_cleanup(ctx.curl_next);
+	}
 	if (ctx.curlm) {
 		curl_multi_cleanup(ctx.curlm);
 	}
 	if (ctx.curl_global_init) {
 		curl_global_cleanup();
 	}
+	if (ctx.loop) {
+		term_loop = NULL;
+		lws_loop_free(ctx.loop);
+	}
 
 	/* cleanup configuration */
 	if (ctx.match.re_nsub > 0) {
@@ -457,6 +690,9 @@ int main (int argc, char *argv[]) {
 	if (ctx.headers) {
 		lws_table_free(ctx.headers);
 	}
+	if (ctx.body.data) {
+		lws_free(ctx.body.data);
+	}
 
 	/* cleanup payload request */
 	if (ctx.req_headers) {
@@ -467,6 +703,16 @@ int main (int argc, char *argv[]) {
 	if (ctx.resp_headers) {
 		lws_table_free(ctx.resp_headers);
 	}
+	lws_region_free(&ctx.resp_region);
+	if (ctx.arena) {
+		lws_arena_free(ctx.arena);
+	}
+	if (ctx.doc_arena) {
+		lws_arena_free(ctx.doc_arena);
+	}
+	if (ctx.json_arena) {
+		lws_arena_free(ctx.json_arena);
+	}
 
 	return rc;
 }
@@ -18,16 +18,30 @@
 #ifndef LWS_STAT_CACHE_CAP
 #define LWS_STAT_CACHE_CAP  1024
 #endif
+#ifndef LWS_ARENA_SIZE
+#define LWS_ARENA_SIZE      16384
+#endif
+#ifndef LWS_RESP_RESERVE
+#define LWS_RESP_RESERVE    ((size_t)1024 * 1024 * 1024)
+#endif
 
 
-typedef struct lws_ctx_s  lws_ctx_t;
+typedef struct lws_ctx_s     lws_ctx_t;
+typedef struct lws_sender_s  lws_sender_t;
+typedef struct lws_heap_s    lws_heap_t;
 
 
 #include <lws_ngx.h>
 #include <lws_log.h>
 #include <lws_table.h>
+#include <lws_arena.h>
+#include <lws_loop.h>
+#include <lws_client.h>
+#include <lws_compress.h>
 
 
+typedef int (*lws_producer_pt)(void *userdata, lws_str_t *chunk);
+
 struct lws_ctx_s {
 	/* configuration */
 	lws_str_t             runtime_api;            /* Lambda runtime API URL */
@@ -41,20 +55,55 @@ struct lws_ctx_s {
 	int                   raw;                    /* raw mode */
 	size_t                state_gc;               /* Lua state explicite GC theshold; 0 = never */
 	lws_int_t             state_req_max;          /* maximum Lua state requests; 0 = unlimited */
+	size_t                state_mem_max;          /* Lua state memory limit; 0 = unlimited */
+	size_t                state_trim;             /* free heap memory triggering a trim; 0 = off */
+	lws_int_t             state_rss;              /* RSS percentage recycling the state; 0 = off */
+	size_t                function_memory;        /* function memory size; 0 = unknown */
 	int                   state_diagnostic;       /* include diagnostic w/ error response */
 	lws_log_level_e       log_level;              /* log level */
 	int                   log_text;               /* log in text format; default JSON */
+	lws_http_client_e     http_client;            /* runtime API HTTP client */
+	int                   overlap;                /* overlap response and next invocation */
+	size_t                progressive;            /* progressive upload increment; 0 = off */
+	size_t                stream_queue;           /* streaming send queue bound; 0 = send inline */
+	size_t                stream_buffer;          /* streaming buffer bound; 0 = unbounded */
+	size_t                stream_flush_bytes;     /* streaming flush size; 0 = explicit flush */
+	lws_int_t             stream_flush_ms;        /* streaming flush age [ms]; 0 = explicit flush */
+	lws_int_t             stream_heartbeat;       /* SSE heartbeat interval [ms]; 0 = off */
+	int                   auto_stream;            /* stream binary or large buffered responses */
+	size_t                auto_stream_threshold;  /* auto stream body size; 0 = binary only */
+	int                   compress;               /* compress responses */
+	lws_int_t             compress_level;         /* compression level; 0 = default */
+	size_t                compress_min;           /* minimum buffered body size to compress */
+	lws_str_t             compress_types;         /* compressible content types */
+	lws_int_t             decompress;             /* request decompression ratio; 0 = off */
+#if LWS_PROFILE
+	lws_int_t             profile_interval;       /* requests per allocation profile report */
+#endif
 
 	/* state */
 	CURL 			     *curl;                   /* CURL handle */
 	CURLM                *curlm;                  /* CURLM handle for streaming */
+	CURL                 *curl_next;              /* CURL handle for overlapped next invocation */
+	lws_client_t         *client;                 /* native runtime API client; NULL = libcurl */
+	lws_loop_t           *loop;                   /* event loop */
+	lws_sender_t         *sender;                 /* streaming sender thread; NULL = inline */
+	lws_compress_t       *compressor;             /* response compressor; NULL = identity */
 	lws_table_t          *stat_cache;             /* file stat cache to reduce syscalls */
+	lws_arena_t          *arena;                  /* request-scoped allocations; reset per request */
+	lws_arena_t          *doc_arena;              /* request document allocations; ditto */
+	lws_arena_t          *json_arena;             /* mutable document and JSON allocations; ditto */
+	yyjson_alc            doc_alc;                /* yyjson allocator for the request document */
+	yyjson_alc            json_alc;               /* yyjson allocator for mutable documents and JSON */
 	lua_State            *L;                      /* Lua state */
+	lws_heap_t           *heap;                   /* Lua state heap */
 	lws_int_t             req_count;              /* requests served */
 	unsigned              curl_global_init:1;     /* CURL global init done */
 	unsigned              streaming_init:1;       /* streaming init done */
 	unsigned              state_init:1;           /* Lua state initialized */
 	unsigned              state_close:1;          /* Lua state is to be closed */ 
+	unsigned              next_pending:1;         /* next invocation request in flight */
+	unsigned              next_hold:1;            /* hold next invocation data */
 
 	/* Lambda request */
 	lws_table_t          *headers;                /* request headers */
@@ -62,7 +111,8 @@ struct lws_ctx_s {
 	off_t                 content_length;         /* content length; -1 if not present or invalid */
 	lws_str_t             body;                   /* request body */
 	size_t                body_cap;               /* request body capacity */
-	yyjson_doc           *doc;                    /* in-place parsed request body */
+	size_t                body_high;              /* request body decaying high-water mark */
+	yyjson_doc           *doc;                    /* in-place parsed request body; lazy */
 
 	/* payload request */
 	lws_str_t             req_method;             /* request method */
@@ -72,8 +122,14 @@ struct lws_ctx_s {
 	lws_str_t             req_main;               /* filename of main Lua chunk */
 	lws_str_t             req_path_info;          /* path info derived from path */
 	lws_table_t          *req_headers;            /* request headers */
-	lws_str_t             req_body;               /* request body */
+	lws_str_t             req_body;               /* request body; raw span until decoded */
 	FILE                 *req_body_file;          /* request body file */
+	size_t                req_body_pos;           /* request body read position if decompressed */
+	unsigned              req_body_escaped:1;     /* request body pending JSON unescape */
+	unsigned              req_body_base64:1;      /* request body pending base64 decode */
+	unsigned              req_body_encoding:2;    /* request body encoding pending decompression */
+	unsigned              req_body_decoded:1;     /* request body decompressed and owned */
+	unsigned              req_body_failed:1;      /* request body decompression failed */
 
 	/* payload response */
 	int                   resp_status;            /* response status code */
@@ -81,11 +137,27 @@ struct lws_ctx_s {
 	FILE                 *resp_body_file;         /* response body file */
 	lws_str_t             resp_body;              /* response body */
 	size_t                resp_body_pos;		  /* response body position for streaming */
-	size_t                resp_body_cap;          /* response body capacity */
+	lws_region_t          resp_region;            /* response body region; committed capacity */
+	size_t                resp_body_high;         /* response body decaying high-water mark */
+	int64_t               stream_pending;         /* time of the oldest unsent streaming data */
+	lws_producer_pt       producer;               /* streaming producer; NULL = none */
+	void                 *producer_data;          /* streaming producer user data */
+	lws_str_t             produced;               /* produced streaming data */
+	size_t                produced_pos;           /* produced streaming data position */
 	lws_str_t             diagnostic;             /* diagnostic information */
+	lws_str_t             envelope;               /* response envelope up to the body */
+	size_t                envelope_pos;           /* response envelope position */
+	lws_str_t             envelope_suffix;        /* response envelope after the body */
+	size_t                envelope_suffix_pos;    /* response envelope suffix position */
+	uint32_t              resp_body_utf8;         /* response body UTF-8 state */
+	size_t                resp_body_utf8_pos;     /* response body position of the UTF-8 state */
+	size_t                resp_body_escaped;      /* JSON-escaped length up to that position */
 	lws_str_t             streaming_prelude;	  /* streaming prelude */
 	size_t                streaming_prelude_pos;  /* streaming prelude position */
-	unsigned              likely_utf8:1;          /* response body is likely valid UTF-8 */
+	unsigned              envelope_base64:1;      /* base64-encode body in envelope */
+	unsigned              uploading:1;            /* progressive upload in flight */
+	unsigned              upload_skip:1;          /* no progressive upload */
+	unsigned              upload_dropped:1;       /* progressive upload dropped after sending */
 	unsigned              streaming:1;            /* streaming response */
 	unsigned              streaming_paused:1;	  /* streaming paused */
 	unsigned              streaming_eof:1;        /* streaming complete */
@@ -5,6 +5,9 @@
  */
 
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <malloc.h>
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
@@ -16,12 +19,41 @@
 #if LUA_VERSION_NUM < 502
 #define LUA_OK  0
 #endif
+#define LWS_HEAP_QUANTUM  16     /* size class granularity and slab alignment */
+#define LWS_HEAP_CLASSES  16     /* small size classes, up to 256 bytes */
+#define LWS_HEAP_LARGE    LWS_HEAP_CLASSES
+#define LWS_HEAP_SLAB     65536  /* slab size for small objects */
+
+
+typedef struct lws_heap_slab_s lws_heap_slab_t;
+
+struct lws_heap_slab_s {
+	lws_heap_slab_t  *next;  /* next slab */
+};
+
+struct lws_heap_s {
+	void             *free[LWS_HEAP_CLASSES];  /* free lists by size class */
+	lws_heap_slab_t  *slabs;                   /* slabs, chained */
+	char             *pos;                     /* slab carve position */
+	char             *end;                     /* slab end */
+	size_t            demoted;                 /* large blocks shrunk in place into a small class */
+	size_t            used;                    /* bytes in use by the state */
+	size_t            max;                     /* limit of bytes in use; 0 = unlimited */
+	size_t            req_used;                /* bytes in use at request start */
+	size_t            req_peak;                /* peak bytes in use during the request */
+};
 
 
 #if LUA_VERSION_NUM < 502
 static void luaL_requiref(lua_State *L, const char *name, lua_CFunction openf, int glb);
 #endif
+static unsigned lws_heap_class(size_t size);
+static void *lws_heap_small(lws_heap_t *h, unsigned c);
+static int lws_heap_in_slab(lws_heap_t *h, void *ptr);
+static void lws_heap_release(lws_heap_t *h, void *ptr, size_t size);
+static void lws_heap_free(lws_heap_t *h);
 static void *lws_lua_alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+static size_t lws_get_rss(void);
 static int lws_init(lua_State *L);
 static int lws_create_state(lws_ctx_t *ctx);
 
@@ -42,12 +74,150 @@ static void luaL_requiref (lua_State *L, const char *name, lua_CFunction openf,
 }
 #endif
 
+
+/*
+ * heap
+ */
+
+static unsigned lws_heap_class (size_t size) {
+	if (size > LWS_HEAP_CLASSES * LWS_HEAP_QUANTUM) {
+		return LWS_HEAP_LARGE;
+	}
+	return (unsigned)((size + LWS_HEAP_QUANTUM - 1) / LWS_HEAP_QUANTUM) - 1;
+}
+
+static void *lws_heap_small (lws_heap_t *h, unsigned c) {
+	char             *p;
+	size_t            size;
+	lws_heap_slab_t  *slab;
+
+	/* free list */
+	if (h->free[c]) {
+		p = h->free[c];
+		h->free[c] = *(void **)p;
+		return p;
+	}
+
+	/* carve from the current slab; the remainder of an exhausted slab is abandoned */
+	size = (c + 1) * LWS_HEAP_QUANTUM;
+	if ((size_t)(h->end - h->pos) < size) {
+		slab = lws_alloc(LWS_HEAP_QUANTUM + LWS_HEAP_SLAB);
+		if (!slab) {
+			return NULL;
+		}
+		slab->next = h->slabs;
+		h->slabs = slab;
+		h->pos = (char *)slab + LWS_HEAP_QUANTUM;
+		h->end = h->pos + LWS_HEAP_SLAB;
+	}
+	p = h->pos;
+	h->pos += size;
+	return p;
+}
+
+static int lws_heap_in_slab (lws_heap_t *h, void *ptr) {
+	char             *data;
+	lws_heap_slab_t  *slab;
+
+	for (slab = h->slabs; slab; slab = slab->next) {
+		data = (char *)slab + LWS_HEAP_QUANTUM;
+		if ((char *)ptr >= data && (char *)ptr < data + LWS_HEAP_SLAB) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void lws_heap_release (lws_heap_t *h, void *ptr, size_t size) {
+	unsigned  c;
+
+	c = lws_heap_class(size);
+	if (c == LWS_HEAP_LARGE) {
+		lws_free(ptr);
+		return;
+	}
+	if (h->demoted && !lws_heap_in_slab(h, ptr)) {
+		/* a large block shrunk in place; it never enters the free lists */
+		lws_free(ptr);
+		h->demoted--;
+		return;
+	}
+	*(void **)ptr = h->free[c];
+	h->free[c] = ptr;
+}
+
+static void lws_heap_free (lws_heap_t *h) {
+	lws_heap_slab_t  *slab, *next;
+
+	for (slab = h->slabs; slab; slab = next) {
+		next = slab->next;
+		lws_free(slab);
+	}
+	lws_free(h);
+}
+
 static void *lws_lua_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
+	void        *p;
+	unsigned     oc, nc;
+	lws_heap_t  *h;
+
+	/* free */
+	h = ud;
+	if (!ptr) {
+		osize = 0;  /* encodes the object type */
+	}
 	if (nsize == 0) {
-		free(ptr);
+		if (ptr) {
+			lws_heap_release(h, ptr, osize);
+			h->used -= osize;
+		}
+		return NULL;
+	}
+
+	/* enforce the limit on growth; Lua responds with a GC cycle, then a memory error */
+	if (nsize > osize && h->max && (h->used > h->max || nsize - osize > h->max - h->used)) {
 		return NULL;
 	}
-	return realloc(ptr, nsize);
+
+	/* same small class, both large, or a move between classes */
+	oc = ptr ? lws_heap_class(osize) : LWS_HEAP_LARGE;
+	nc = lws_heap_class(nsize);
+	if (ptr && oc == nc && nc != LWS_HEAP_LARGE) {
+		p = ptr;
+	} else if (ptr && oc == LWS_HEAP_LARGE && nc == LWS_HEAP_LARGE) {
+		p = lws_realloc(ptr, nsize);
+		if (!p) {
+			return NULL;
+		}
+	} else {
+		p = nc != LWS_HEAP_LARGE ? lws_heap_small(h, nc) : lws_alloc(nsize);
+		if (p) {
+			if (ptr) {
+				memcpy(p, ptr, osize < nsize ? osize : nsize);
+				lws_heap_release(h, ptr, osize);
+			}
+		} else if (ptr && nsize < osize) {
+			/* shrinking must not fail; the block is large enough for its new class, and a large
+			 * block is shrunk in place to the class size and released as such */
+			p = ptr;
+			if (oc == LWS_HEAP_LARGE) {
+				p = lws_realloc(ptr, (nc + 1) * LWS_HEAP_QUANTUM);
+				if (!p) {
+					p = ptr;
+				}
+				h->demoted++;
+			}
+		} else {
+			return NULL;
+		}
+	}
+
+	/* account */
+	h->used = h->used - osize + nsize;
+	if (h->used > h->req_peak) {
+		h->req_peak = h->used;
+	}
+	return p;
 }
 
 static int lws_init (lua_State *L) {
@@ -60,12 +230,58 @@ static int lws_init (lua_State *L) {
 	return 0;
 }
 
+
+/*
+ * RSS
+ */
+
+static size_t lws_get_rss (void) {
+	int      fd;
+	char     buf[128], *p, *end;
+	ssize_t  n;
+	size_t   pages;
+
+	/* second field of statm; resident pages */
+	fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return 0;
+	}
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0) {
+		return 0;
+	}
+	buf[n] = '\0';
+	p = strchr(buf, ' ');
+	if (!p) {
+		return 0;
+	}
+	pages = (size_t)strtoull(p + 1, &end, 10);
+	if (end == p + 1) {
+		return 0;
+	}
+	return pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+
+/*
+ * state
+ */
+
 static int lws_create_state (lws_ctx_t *ctx) {
 	lws_str_t  msg;
 
-	ctx->L = lua_newstate(lws_lua_alloc, NULL);
+	ctx->heap = lws_calloc(sizeof(lws_heap_t));
+	if (!ctx->heap) {
+		lws_log(LWS_LOG_EMERG, "failed to create Lua state heap");
+		return -1;
+	}
+	ctx->heap->max = ctx->state_mem_max;
+	ctx->L = lua_newstate(lws_lua_alloc, ctx->heap);
 	if (!ctx->L) {
 		lws_log(LWS_LOG_EMERG, "failed to create Lua state");
+		lws_heap_free(ctx->heap);
+		ctx->heap = NULL;
 		return -1;
 	}
 
@@ -76,6 +292,8 @@ static int lws_create_state (lws_ctx_t *ctx) {
 		lws_log(LWS_LOG_EMERG, "failed to initialize Lua state: %s", msg.data);
 		lua_close(ctx->L);
 		ctx->L = NULL;
+		lws_heap_free(ctx->heap);
+		ctx->heap = NULL;
 		return -1;
 	}
 
@@ -88,9 +306,11 @@ static int lws_create_state (lws_ctx_t *ctx) {
 
 void lws_close_state (lws_ctx_t *ctx) {
 	lua_close(ctx->L);
+	lws_heap_free(ctx->heap);
 	lws_log(LWS_LOG_INFO, "%s state closed L:%p req_count:%ld", LUA_VERSION, ctx->L, 
 			(long)ctx->req_count);
 	ctx->L = NULL;
+	ctx->heap = NULL;
 	ctx->req_count = 0;
 	ctx->state_init = 0;
 	ctx->state_close = 0;
@@ -108,6 +328,10 @@ int lws_acquire_state (lws_ctx_t *ctx) {
 void lws_release_state (lws_ctx_t *ctx) {
 	size_t  memory_used, memory_used_after;
 
+	/* account memory */
+	lws_log_debug("state memory used:%zu request:%td peak:%zu", ctx->heap->used,
+			(ptrdiff_t)(ctx->heap->used - ctx->heap->req_used), ctx->heap->req_peak);
+
 	/* close state? */
 	ctx->req_count++;
 	if (ctx->state_close || (ctx->state_req_max > 0 && ctx->req_count >= ctx->state_req_max)) {
@@ -133,6 +357,10 @@ int lws_run_state (lws_ctx_t *ctx) {
 	int        rc;
 	lws_str_t  msg;
 
+	/* start request accounting */
+	ctx->heap->req_used = ctx->heap->used;
+	ctx->heap->req_peak = ctx->heap->used;
+
 	/* prepare stack */
 	lua_pushcfunction(ctx->L, lws_run);
 	lua_pushlightuserdata(ctx->L, ctx);  /* [traceback, function, ctx] */
@@ -153,7 +381,7 @@ int lws_run_state (lws_ctx_t *ctx) {
 		}
 
 		/* store error message */
-		ctx->diagnostic.data = lws_alloc(msg.len);
+		ctx->diagnostic.data = lws_arena_alloc(ctx->arena, msg.len);
 		if (!ctx->diagnostic.data) {
 			goto done;
 		}
@@ -167,3 +395,42 @@ int lws_run_state (lws_ctx_t *ctx) {
 
 	return rc;
 }
+
+void lws_govern_state (lws_ctx_t *ctx) {
+	size_t            rss, rss_after, limit;
+	struct mallinfo2  mi;
+
+	/* sample */
+	if (!ctx->state_trim && !(ctx->state_rss && ctx->function_memory)) {
+		return;
+	}
+	rss = lws_get_rss();
+	if (!rss) {
+		return;
+	}
+
+	/* trim the heap if the allocator holds too much free memory */
+	if (ctx->state_trim) {
+		mi = mallinfo2();
+		if (mi.fordblks >= ctx->state_trim) {
+			malloc_trim(0);
+			rss_after = lws_get_rss();
+			lws_log(LWS_LOG_NOTICE, "trim free:%zu rss:%zu after:%zu", mi.fordblks, rss,
+					rss_after);
+			if (rss_after) {
+				rss = rss_after;
+			}
+		}
+	}
+
+	/* recycle the Lua state if RSS approaches the function memory size */
+	if (ctx->state_rss && ctx->function_memory && ctx->L) {
+		limit = ctx->function_memory / 100 * (size_t)ctx->state_rss;
+		if (rss >= limit) {
+			lws_close_state(ctx);
+			malloc_trim(0);
+			rss_after = lws_get_rss();
+			lws_log(LWS_LOG_NOTICE, "recycle rss:%zu limit:%zu after:%zu", rss, limit, rss_after);
+		}
+	}
+}
@@ -15,6 +15,7 @@
 void lws_close_state(lws_ctx_t *ctx);
 int lws_acquire_state(lws_ctx_t *ctx);
 void lws_release_state(lws_ctx_t *ctx);
+void lws_govern_state(lws_ctx_t *ctx);
 int lws_run_state(lws_ctx_t *ctx);
 
 
@@ -0,0 +1,12 @@
+-- Binary response of configurable size (base64-encoded in buffered mode)
+local n = tonumber(lws.parseargs(request.args).n) or 4096
+response.headers["Content-Type"] = "application/octet-stream"
+local block = { }
+for i = 1, 256 do
+	block[i] = string.char(i - 1)
+end
+block = table.concat(block)
+for i = 1, math.floor(n / 256) do
+	response.body:write(block)
+end
+response.body:write(block:sub(1, n % 256))
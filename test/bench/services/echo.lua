@@ -0,0 +1,4 @@
+-- Echo the request body
+local body = request.body:read("*a")
+response.headers["Content-Type"] = request.headers["Content-Type"] or "application/octet-stream"
+response.body:write(body)
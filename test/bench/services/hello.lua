@@ -0,0 +1,3 @@
+-- Minimal buffered response
+response.headers["Content-Type"] = "text/plain"
+response.body:write("Hello, world!\n")
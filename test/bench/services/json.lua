@@ -0,0 +1,12 @@
+-- JSON list response of configurable size
+local n = tonumber(lws.parseargs(request.args).n) or 100
+response.headers["Content-Type"] = "application/json"
+response.body:write("[")
+for i = 1, n do
+	if i > 1 then
+		response.body:write(",")
+	end
+	response.body:write("{\"id\":", i, ",\"name\":\"item ", i, "\",\"tags\":[\"a\",\"b\"],",
+			"\"description\":\"Lorem ipsum dolor sit amet, \\\"consectetur\\\" adipiscing.\"}")
+end
+response.body:write("]")
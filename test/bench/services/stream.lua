@@ -0,0 +1,7 @@
+-- Streaming response with several flushes
+local n = tonumber(lws.parseargs(request.args).n) or 8
+response.headers["Content-Type"] = "text/plain"
+for i = 1, n do
+	response.body:write("line ", i, "\n")
+	response.body:flush()
+end
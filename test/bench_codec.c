@@ -0,0 +1,195 @@
+/*
+ * LWS codec benchmark
+ *
+ * Measures the throughput of the UTF-8 validation, JSON escaping, and base64 kernels for each
+ * instruction set supported by the CPU.
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <lws_codec.h>
+
+
+typedef enum {
+	BENCH_UTF8_ASCII,
+	BENCH_UTF8_MIXED,
+	BENCH_UTF8_ESCAPE_LEN,
+	BENCH_JSON_ESCAPE,
+	BENCH_BASE64_ENCODE,
+	BENCH_BASE64_DECODE,
+	BENCH_MAX
+} bench_op_e;
+
+
+static void bench_fatal(const char *msg) __attribute__((noreturn));
+static uint64_t bench_now(void);
+static void bench_fill(uint8_t *p, size_t n, int mixed);
+static double bench_run(bench_op_e op, uint8_t *buf, const uint8_t *src, size_t size, long rounds);
+static void bench_usage(void);
+int main(int argc, char *argv[]);
+
+
+static const char *bench_op_names[BENCH_MAX] = { "utf8 ascii", "utf8 mixed", "utf8+escape len",
+		"json escape", "base64 encode", "base64 decode" };
+
+
+static void bench_fatal (const char *msg) {
+	fprintf(stderr, "bench_codec: %s\n", msg);
+	exit(EXIT_FAILURE);
+}
+
+static uint64_t bench_now (void) {
+	struct timespec  ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_fill (uint8_t *p, size_t n, int mixed) {
+	size_t    i;
+	uint32_t  seed;
+
+	/* JSON-like text; mixed adds a 2- or 3-byte sequence roughly every 16 characters */
+	seed = 1;
+	for (i = 0; i < n; ) {
+		seed = seed * 1103515245 + 12345;
+		if (mixed && (seed >> 16) % 16 == 0 && n - i >= 3) {
+			if (seed & 1) {
+				memcpy(p + i, "\xc3\xa9", 2);
+				i += 2;
+			} else {
+				memcpy(p + i, "\xe2\x82\xac", 3);
+				i += 3;
+			}
+		} else {
+			p[i++] = (uint8_t)(' ' + (seed >> 24) % 95);
+		}
+	}
+}
+
+static double bench_run (bench_op_e op, uint8_t *buf, const uint8_t *src, size_t size,
+		long rounds) {
+	long      r;
+	size_t    len;
+	uint64_t  start;
+
+	start = bench_now();
+	for (r = 0; r < rounds; r++) {
+		switch (op) {
+		case BENCH_UTF8_ASCII:
+		case BENCH_UTF8_MIXED:
+			if (lws_valid_utf8(src, size) != 0) {
+				bench_fatal("invalid UTF-8");
+			}
+			break;
+
+		case BENCH_UTF8_ESCAPE_LEN:
+			len = 0;
+			if (lws_utf8_escape_update(LWS_UTF8_ACCEPT, src, size, &len) != LWS_UTF8_ACCEPT) {
+				bench_fatal("invalid UTF-8");
+			}
+			break;
+
+		case BENCH_JSON_ESCAPE:
+			len = size;
+			lws_json_escape(src, &len, buf, size * 2);
+			break;
+
+		case BENCH_BASE64_ENCODE:
+			lws_base64_encode_to(src, size, buf);
+			break;
+
+		case BENCH_BASE64_DECODE:
+			len = size;
+			if (lws_base64_decode_to(src, size, buf, &len) != 0) {
+				bench_fatal("invalid base64");
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+	return (double)size * rounds / (double)(bench_now() - start);
+}
+
+static void bench_usage (void) {
+	fprintf(stderr, "usage: bench_codec [-s size] [-n rounds]\n");
+	exit(EXIT_FAILURE);
+}
+
+int main (int argc, char *argv[]) {
+	int       opt, isa, op;
+	long      rounds;
+	size_t    size, len;
+	uint8_t  *ascii, *mixed, *encoded, *buf;
+
+	/* configuration */
+	size = 1024 * 1024;
+	rounds = 200;
+	while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+		switch (opt) {
+		case 's':
+			size = (size_t)atol(optarg);
+			break;
+
+		case 'n':
+			rounds = atol(optarg);
+			break;
+
+		default:
+			bench_usage();
+		}
+	}
+	if (size < 3 || rounds <= 0) {
+		bench_usage();
+	}
+	size -= size % 3;
+
+	/* inputs */
+	ascii = malloc(size);
+	mixed = malloc(size);
+	encoded = malloc(size / 3 * 4);
+	buf = malloc(size * 2);  /* escaping at most doubles the printable input */
+	if (!ascii || !mixed || !encoded || !buf) {
+		bench_fatal("out of memory");
+	}
+	bench_fill(ascii, size, 0);
+	bench_fill(mixed, size, 1);
+	memcpy(encoded, mixed, size);
+	len = size;
+	lws_base64_encode(encoded, &len);
+
+	/* measure */
+	printf("%-14s", "GB/s");
+	for (op = 0; op < BENCH_MAX; op++) {
+		printf("%16s", bench_op_names[op]);
+	}
+	printf("\n");
+	for (isa = LWS_CODEC_SCALAR; isa <= LWS_CODEC_AVX512; isa++) {
+		if (lws_codec_set_isa((lws_codec_isa_e)isa) != 0) {
+			continue;
+		}
+		printf("%-14s", lws_codec_isa_name((lws_codec_isa_e)isa));
+		printf("%16.2f", bench_run(BENCH_UTF8_ASCII, buf, ascii, size, rounds));
+		printf("%16.2f", bench_run(BENCH_UTF8_MIXED, buf, mixed, size, rounds));
+		printf("%16.2f", bench_run(BENCH_UTF8_ESCAPE_LEN, buf, mixed, size, rounds));
+		printf("%16.2f", bench_run(BENCH_JSON_ESCAPE, buf, mixed, size, rounds));
+		printf("%16.2f", bench_run(BENCH_BASE64_ENCODE, buf, mixed, size, rounds));
+		printf("%16.2f", bench_run(BENCH_BASE64_DECODE, buf, encoded, len, rounds));
+		printf("\n");
+	}
+
+	free(ascii);
+	free(mixed);
+	free(encoded);
+	free(buf);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,948 @@
+/*
+ * LWS end-to-end benchmark
+ *
+ * Emulates the AWS Lambda runtime API on a loopback socket and drives an unmodified bootstrap
+ * binary through a corpus of payload events.
+ *
+ * Copyright (C) 2026 Andre Naef
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+
+#define BENCH_CONN_MAX         16
+#define BENCH_EVENT_MAX        256
+#define BENCH_RSS_SAMPLE_MAX   4096
+#define BENCH_RSS_REPORT_MAX   20
+#define BENCH_RUNTIME_VERSION  "/2018-06-01"
+#define BENCH_NEXT_PATH        BENCH_RUNTIME_VERSION "/runtime/invocation/next"
+#define BENCH_INVOCATION_PATH  BENCH_RUNTIME_VERSION "/runtime/invocation/"
+#define BENCH_INIT_ERROR_PATH  BENCH_RUNTIME_VERSION "/runtime/init/error"
+#define BENCH_TERM_TIMEOUT_MS  3000
+#define BENCH_TAIL_MAX         64
+
+
+typedef struct bench_event_s bench_event_t;
+typedef struct bench_conn_s bench_conn_t;
+typedef struct bench_s bench_t;
+
+typedef enum {
+	BENCH_CS_HEAD,
+	BENCH_CS_BODY,
+	BENCH_CS_CHUNK_SIZE,
+	BENCH_CS_CHUNK_DATA,
+	BENCH_CS_CHUNK_CRLF,
+	BENCH_CS_TRAILER,
+	BENCH_CS_PARKED
+} bench_conn_state_e;
+
+struct bench_event_s {
+	char    *name;  /* file name */
+	char    *data;  /* event JSON */
+	size_t   len;   /* event length */
+};
+
+struct bench_conn_s {
+	int                  fd;            /* socket; -1 if unused */
+	bench_conn_state_e   state;         /* parser state */
+	char                *buf;           /* input buffer */
+	size_t               len;           /* input buffer length */
+	size_t               cap;           /* input buffer capacity */
+	size_t               pos;           /* parser position */
+	char                 method[8];     /* request method */
+	char                 path[256];     /* request path */
+	size_t               remain;        /* remaining body or chunk bytes */
+	size_t               body_len;      /* decoded body length */
+	char                 tail[BENCH_TAIL_MAX];  /* last decoded body bytes */
+	size_t               tail_len;      /* last decoded body bytes length */
+	unsigned             chunked:1;     /* chunked request body */
+	unsigned             close:1;       /* close after response */
+};
+
+struct bench_s {
+	/* configuration */
+	long              invocations;   /* measured invocations */
+	long              warmup;        /* warmup invocations */
+	long              rss_interval;  /* RSS sampling interval [ms] */
+	int               verbose;       /* pass child output */
+	char             *events_path;   /* event file or directory */
+	char             *task_root;     /* Lambda task root */
+	char            **argv;          /* bootstrap command */
+	const char       *expect;        /* expected response body suffix; NULL = unchecked */
+
+	/* corpus */
+	bench_event_t     events[BENCH_EVENT_MAX];
+	int               event_count;
+
+	/* state */
+	int               lfd;           /* listening socket */
+	bench_conn_t      conns[BENCH_CONN_MAX];
+	bench_conn_t     *parked;        /* connection waiting for the next invocation */
+	pid_t             pid;           /* bootstrap process */
+	int               exited;        /* bootstrap exited */
+	int               status;        /* bootstrap exit status */
+	long              served;        /* invocations served */
+	long              completed;     /* invocations completed */
+	long              errors;        /* invocation errors */
+	long              truncated;     /* responses lacking the expected suffix */
+	int               in_flight;     /* invocation in flight */
+	char              request_id[64];
+	uint64_t          t_served;      /* invocation served time [ns] */
+	uint64_t          t_first_byte;  /* first response byte time [ns]; 0 if none yet */
+	uint64_t          t_start;       /* measurement start [ns] */
+	uint64_t          t_end;         /* measurement end [ns] */
+	uint64_t          t_rss;         /* last RSS sample time [ns] */
+	uint64_t         *latency;       /* invocation latencies [ns] */
+	uint64_t         *ttfb;          /* time to first response byte [ns] */
+	uint64_t          bytes_in;      /* bytes received from bootstrap (measured) */
+	uint64_t          bytes_out;     /* bytes sent to bootstrap (measured) */
+	uint64_t          rss_t[BENCH_RSS_SAMPLE_MAX];
+	uint64_t          rss[BENCH_RSS_SAMPLE_MAX];
+	int               rss_count;
+	long              page_size;
+};
+
+
+static void bench_fatal(const char *fmt, ...) __attribute__((format(printf, 1, 2), noreturn));
+static uint64_t bench_now(void);
+static int bench_cmp_u64(const void *a, const void *b);
+static int bench_load_event(bench_t *b, const char *dir, const char *name);
+static int bench_load_events(bench_t *b);
+static int bench_listen(bench_t *b, int port);
+static void bench_spawn(bench_t *b);
+static void bench_sample_rss(bench_t *b, uint64_t now);
+static int bench_measured(bench_t *b);
+static void bench_send(bench_t *b, bench_conn_t *c, const char *status, const char *extra,
+		const char *body, size_t body_len);
+static void bench_close(bench_conn_t *c);
+static void bench_serve_next(bench_t *b, bench_conn_t *c);
+static void bench_body_bytes(bench_t *b, bench_conn_t *c, const char *data, size_t n);
+static int bench_body_ends(bench_conn_t *c, const char *suffix);
+static void bench_complete(bench_t *b, bench_conn_t *c);
+static int bench_parse_head(bench_t *b, bench_conn_t *c);
+static int bench_parse(bench_t *b, bench_conn_t *c);
+static void bench_read(bench_t *b, bench_conn_t *c);
+static void bench_accept(bench_t *b);
+static void bench_terminate(bench_t *b);
+static void bench_report(bench_t *b);
+static void bench_usage(void);
+int main(int argc, char *argv[]);
+
+
+static void bench_fatal (const char *fmt, ...) {
+	va_list  ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "bench_e2e: ");
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+	exit(EXIT_FAILURE);
+}
+
+static uint64_t bench_now (void) {
+	struct timespec  ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int bench_cmp_u64 (const void *a, const void *b) {
+	uint64_t  x, y;
+
+	x = *(const uint64_t *)a;
+	y = *(const uint64_t *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+
+/*
+ * corpus
+ */
+
+static int bench_load_event (bench_t *b, const char *dir, const char *name) {
+	FILE           *f;
+	char            path[4096];
+	long            len;
+	bench_event_t  *e;
+
+	if (b->event_count == BENCH_EVENT_MAX) {
+		bench_fatal("too many events");
+	}
+	if (dir) {
+		snprintf(path, sizeof(path), "%s/%s", dir, name);
+	} else {
+		snprintf(path, sizeof(path), "%s", name);
+	}
+	f = fopen(path, "rb");
+	if (!f) {
+		bench_fatal("failed to open event file:%s", path);
+	}
+	if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+		bench_fatal("failed to size event file:%s", path);
+	}
+	e = &b->events[b->event_count++];
+	e->name = strdup(name);
+	e->data = malloc((size_t)len + 1);
+	if (!e->name || !e->data) {
+		bench_fatal("out of memory");
+	}
+	if (fread(e->data, 1, (size_t)len, f) != (size_t)len) {
+		bench_fatal("failed to read event file:%s", path);
+	}
+	e->data[len] = '\0';
+	e->len = (size_t)len;
+	fclose(f);
+	return 0;
+}
+
+static int bench_load_events (bench_t *b) {
+	int              i, n;
+	size_t           len;
+	struct stat      sb;
+	struct dirent  **names;
+
+	if (stat(b->events_path, &sb) != 0) {
+		bench_fatal("failed to stat events path:%s", b->events_path);
+	}
+	if (!S_ISDIR(sb.st_mode)) {
+		return bench_load_event(b, NULL, b->events_path);
+	}
+	n = scandir(b->events_path, &names, NULL, alphasort);
+	if (n < 0) {
+		bench_fatal("failed to scan events directory:%s", b->events_path);
+	}
+	for (i = 0; i < n; i++) {
+		len = strlen(names[i]->d_name);
+		if (len > 5 && strcmp(names[i]->d_name + len - 5, ".json") == 0) {
+			bench_load_event(b, b->events_path, names[i]->d_name);
+		}
+		free(names[i]);
+	}
+	free(names);
+	if (b->event_count == 0) {
+		bench_fatal("no events found in:%s", b->events_path);
+	}
+	return 0;
+}
+
+
+/*
+ * process
+ */
+
+static int bench_listen (bench_t *b, int port) {
+	int                 one;
+	socklen_t           len;
+	struct sockaddr_in  addr;
+
+	b->lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (b->lfd < 0) {
+		bench_fatal("failed to create socket: %s", strerror(errno));
+	}
+	one = 1;
+	setsockopt(b->lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons((uint16_t)port);
+	if (bind(b->lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		bench_fatal("failed to bind socket: %s", strerror(errno));
+	}
+	if (listen(b->lfd, BENCH_CONN_MAX) != 0) {
+		bench_fatal("failed to listen: %s", strerror(errno));
+	}
+	len = sizeof(addr);
+	if (getsockname(b->lfd, (struct sockaddr *)&addr, &len) != 0) {
+		bench_fatal("failed to get socket name: %s", strerror(errno));
+	}
+	return ntohs(addr.sin_port);
+}
+
+static void bench_spawn (bench_t *b) {
+	int   fd;
+
+	b->pid = fork();
+	if (b->pid < 0) {
+		bench_fatal("failed to fork: %s", strerror(errno));
+	}
+	if (b->pid == 0) {
+		if (!b->verbose) {
+			fd = open("/dev/null", O_WRONLY);
+			if (fd >= 0) {
+				dup2(fd, STDOUT_FILENO);
+				close(fd);
+			}
+		}
+		execvp(b->argv[0], b->argv);
+		fprintf(stderr, "bench_e2e: failed to exec %s: %s\n", b->argv[0], strerror(errno));
+		_exit(127);
+	}
+}
+
+static void bench_sample_rss (bench_t *b, uint64_t now) {
+	FILE           *f;
+	char            path[64];
+	unsigned long   size, resident;
+
+	if (b->rss_count == BENCH_RSS_SAMPLE_MAX) {
+		/* halve the resolution to bound memory on long runs */
+		for (b->rss_count = 0; b->rss_count < BENCH_RSS_SAMPLE_MAX / 2; b->rss_count++) {
+			b->rss_t[b->rss_count] = b->rss_t[b->rss_count * 2];
+			b->rss[b->rss_count] = b->rss[b->rss_count * 2];
+		}
+		b->rss_interval *= 2;
+	}
+	snprintf(path, sizeof(path), "/proc/%ld/statm", (long)b->pid);
+	f = fopen(path, "r");
+	if (!f) {
+		return;
+	}
+	if (fscanf(f, "%lu %lu", &size, &resident) == 2) {
+		b->rss_t[b->rss_count] = now;
+		b->rss[b->rss_count] = (uint64_t)resident * (uint64_t)b->page_size;
+		b->rss_count++;
+	}
+	fclose(f);
+	b->t_rss = now;
+}
+
+static int bench_measured (bench_t *b) {
+	return b->served > b->warmup;
+}
+
+
+/*
+ * runtime API emulation
+ */
+
+static void bench_send (bench_t *b, bench_conn_t *c, const char *status, const char *extra,
+		const char *body, size_t body_len) {
+	int            n;
+	char           head[1024];
+	size_t         total, sent;
+	ssize_t        rc;
+	struct pollfd  pfd;
+
+	n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: application/json\r\n"
+			"Content-Length: %zu\r\n%s%s\r\n", status, body_len, extra ? extra : "",
+			c->close ? "Connection: close\r\n" : "");
+	total = (size_t)n + body_len;
+	sent = 0;
+	while (sent < total) {
+		if (sent < (size_t)n) {
+			rc = send(c->fd, head + sent, (size_t)n - sent, MSG_NOSIGNAL | (body_len ? MSG_MORE
+					: 0));
+		} else {
+			rc = send(c->fd, body + sent - n, total - sent, MSG_NOSIGNAL);
+		}
+		if (rc < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				pfd.fd = c->fd;
+				pfd.events = POLLOUT;
+				(void)poll(&pfd, 1, 1000);
+				continue;
+			}
+			bench_close(c);
+			return;
+		}
+		sent += (size_t)rc;
+	}
+	if (bench_measured(b)) {
+		b->bytes_out += total;
+	}
+	if (c->close) {
+		bench_close(c);
+	}
+}
+
+static void bench_close (bench_conn_t *c) {
+	if (c->fd >= 0) {
+		close(c->fd);
+	}
+	free(c->buf);
+	memset(c, 0, sizeof(*c));
+	c->fd = -1;
+}
+
+static void bench_serve_next (bench_t *b, bench_conn_t *c) {
+	char            extra[512];
+	uint64_t        deadline;
+	bench_event_t  *e;
+	struct timespec ts;
+
+	e = &b->events[b->served % b->event_count];
+	b->served++;
+	if (b->served == b->warmup + 1) {
+		b->t_start = bench_now();
+	}
+	snprintf(b->request_id, sizeof(b->request_id), "bench-%08ld", b->served);
+	clock_gettime(CLOCK_REALTIME, &ts);
+	deadline = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000 + 30000;
+	snprintf(extra, sizeof(extra), "Lambda-Runtime-Aws-Request-Id: %s\r\n"
+			"Lambda-Runtime-Deadline-Ms: %llu\r\n"
+			"Lambda-Runtime-Invoked-Function-Arn: "
+			"arn:aws:lambda:us-east-1:000000000000:function:bench\r\n"
+			"Lambda-Runtime-Trace-Id: Root=1-00000000-000000000000000000000000;Sampled=0\r\n",
+			b->request_id, (unsigned long long)deadline);
+	b->in_flight = 1;
+	b->t_first_byte = 0;
+	c->state = BENCH_CS_HEAD;
+	b->t_served = bench_now();
+	bench_send(b, c, "200 OK", extra, e->data, e->len);
+}
+
+static void bench_body_bytes (bench_t *b, bench_conn_t *c, const char *data, size_t n) {
+	size_t  keep;
+
+	c->body_len += n;
+	if (n >= BENCH_TAIL_MAX) {
+		memcpy(c->tail, data + n - BENCH_TAIL_MAX, BENCH_TAIL_MAX);
+		c->tail_len = BENCH_TAIL_MAX;
+	} else if (n) {
+		keep = c->tail_len + n > BENCH_TAIL_MAX ? BENCH_TAIL_MAX - n : c->tail_len;
+		memmove(c->tail, c->tail + c->tail_len - keep, keep);
+		memcpy(c->tail + keep, data, n);
+		c->tail_len = keep + n;
+	}
+	if (n && b->in_flight && !b->t_first_byte && strncmp(c->path, BENCH_INVOCATION_PATH,
+			sizeof(BENCH_INVOCATION_PATH) - 1) == 0) {
+		b->t_first_byte = bench_now();
+	}
+}
+
+static int bench_body_ends (bench_conn_t *c, const char *suffix) {
+	size_t  len, n;
+
+	/* a final line feed is ignored */
+	len = c->tail_len;
+	if (len && c->tail[len - 1] == '\n') {
+		len--;
+	}
+	n = strlen(suffix);
+	return n <= len && memcmp(c->tail + len - n, suffix, n) == 0;
+}
+
+static void bench_complete (bench_t *b, bench_conn_t *c) {
+	char      *id, *kind;
+	size_t     id_len;
+	uint64_t   now;
+	long       idx;
+
+	/* next invocation */
+	if (strcmp(c->method, "GET") == 0 && strcmp(c->path, BENCH_NEXT_PATH) == 0) {
+		if (b->in_flight || b->served >= b->warmup + b->invocations) {
+			/* long poll until the current invocation completes, or forever when done */
+			c->state = BENCH_CS_PARKED;
+			b->parked = c;
+			return;
+		}
+		bench_serve_next(b, c);
+		return;
+	}
+
+	/* init error */
+	if (strcmp(c->method, "POST") == 0 && strcmp(c->path, BENCH_INIT_ERROR_PATH) == 0) {
+		fprintf(stderr, "bench_e2e: bootstrap reported an initialization error\n");
+		c->close = 1;
+		bench_send(b, c, "202 Accepted", NULL, "{\"status\":\"OK\"}", 15);
+		bench_terminate(b);
+		exit(EXIT_FAILURE);
+	}
+
+	/* invocation response or error */
+	if (strcmp(c->method, "POST") == 0 && strncmp(c->path, BENCH_INVOCATION_PATH,
+			sizeof(BENCH_INVOCATION_PATH) - 1) == 0) {
+		id = c->path + sizeof(BENCH_INVOCATION_PATH) - 1;
+		kind = strchr(id, '/');
+		id_len = kind ? (size_t)(kind - id) : 0;
+		if (!b->in_flight || !kind || id_len != strlen(b->request_id)
+				|| strncmp(id, b->request_id, id_len) != 0) {
+			bench_send(b, c, "400 Bad Request", NULL, "{\"status\":\"InvalidRequestID\"}", 29);
+			return;
+		}
+		if (strcmp(kind, "/error") == 0) {
+			b->errors++;
+		} else if (strcmp(kind, "/response") != 0) {
+			bench_send(b, c, "404 Not Found", NULL, "{\"status\":\"NotFound\"}", 21);
+			return;
+		} else if (b->expect && !bench_body_ends(c, b->expect)) {
+			b->truncated++;
+			fprintf(stderr, "bench_e2e: response body lacks the expected suffix len:%zu\n",
+					c->body_len);
+		}
+		now = bench_now();
+		if (bench_measured(b)) {
+			idx = b->completed++;
+			b->latency[idx] = now - b->t_served;
+			b->ttfb[idx] = (b->t_first_byte ? b->t_first_byte : now) - b->t_served;
+			if (b->completed == b->invocations) {
+				b->t_end = now;
+			}
+		}
+		b->in_flight = 0;
+		bench_send(b, c, "202 Accepted", NULL, "{\"status\":\"OK\"}", 15);
+		if (b->parked && b->served < b->warmup + b->invocations) {
+			c = b->parked;
+			b->parked = NULL;
+			bench_serve_next(b, c);
+		}
+		return;
+	}
+
+	bench_send(b, c, "404 Not Found", NULL, "{\"status\":\"NotFound\"}", 21);
+}
+
+static int bench_parse_head (bench_t *b, bench_conn_t *c) {
+	char    *end, *line, *next, *colon, *val;
+	size_t   head_len;
+
+	end = memmem(c->buf + c->pos, c->len - c->pos, "\r\n\r\n", 4);
+	if (!end) {
+		return 0;
+	}
+	head_len = (size_t)(end - (c->buf + c->pos)) + 4;
+	*end = '\0';
+	line = c->buf + c->pos;
+	c->pos += head_len;
+
+	/* request line */
+	next = strstr(line, "\r\n");
+	if (next) {
+		*next = '\0';
+		next += 2;
+	}
+	if (sscanf(line, "%7s %255s", c->method, c->path) != 2) {
+		return -1;
+	}
+
+	/* headers */
+	c->remain = 0;
+	c->chunked = 0;
+	c->close = 0;
+	c->body_len = 0;
+	c->tail_len = 0;
+	while (next && *next) {
+		line = next;
+		next = strstr(line, "\r\n");
+		if (next) {
+			*next = '\0';
+			next += 2;
+		}
+		colon = strchr(line, ':');
+		if (!colon) {
+			continue;
+		}
+		*colon = '\0';
+		val = colon + 1;
+		while (*val == ' ' || *val == '\t') {
+			val++;
+		}
+		if (strcasecmp(line, "Content-Length") == 0) {
+			c->remain = strtoul(val, NULL, 10);
+		} else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasecmp(val, "chunked") == 0) {
+			c->chunked = 1;
+		} else if (strcasecmp(line, "Connection") == 0 && strcasecmp(val, "close") == 0) {
+			c->close = 1;
+		}
+	}
+	if (bench_measured(b)) {
+		b->bytes_in += head_len;
+	}
+	c->state = c->chunked ? BENCH_CS_CHUNK_SIZE : BENCH_CS_BODY;
+	return 1;
+}
+
+static int bench_parse (bench_t *b, bench_conn_t *c) {
+	int      rc, head;
+	char    *eol;
+	size_t   n, start;
+
+	while (1) {
+		start = c->pos;
+		head = c->state == BENCH_CS_HEAD;
+		switch (c->state) {
+		case BENCH_CS_HEAD:
+			if ((rc = bench_parse_head(b, c)) <= 0) {
+				return rc;
+			}
+			continue;
+
+		case BENCH_CS_BODY:
+			n = c->len - c->pos < c->remain ? c->len - c->pos : c->remain;
+			c->pos += n;
+			c->remain -= n;
+			bench_body_bytes(b, c, c->buf + c->pos - n, n);
+			if (c->remain) {
+				break;
+			}
+			c->state = BENCH_CS_HEAD;
+			bench_complete(b, c);
+			break;
+
+		case BENCH_CS_CHUNK_SIZE:
+			eol = memmem(c->buf + c->pos, c->len - c->pos, "\r\n", 2);
+			if (!eol) {
+				return 0;
+			}
+			c->remain = strtoul(c->buf + c->pos, NULL, 16);
+			c->pos = (size_t)(eol - c->buf) + 2;
+			c->state = c->remain ? BENCH_CS_CHUNK_DATA : BENCH_CS_TRAILER;
+			break;
+
+		case BENCH_CS_CHUNK_DATA:
+			n = c->len - c->pos < c->remain ? c->len - c->pos : c->remain;
+			c->pos += n;
+			c->remain -= n;
+			bench_body_bytes(b, c, c->buf + c->pos - n, n);
+			if (!c->remain) {
+				c->state = BENCH_CS_CHUNK_CRLF;
+			}
+			break;
+
+		case BENCH_CS_CHUNK_CRLF:
+			if (c->len - c->pos < 2) {
+				return 0;
+			}
+			c->pos += 2;
+			c->state = BENCH_CS_CHUNK_SIZE;
+			break;
+
+		case BENCH_CS_TRAILER:
+			eol = memmem(c->buf + c->pos, c->len - c->pos, "\r\n", 2);
+			if (!eol) {
+				return 0;
+			}
+			c->pos = (size_t)(eol - c->buf) + 2;
+			if (eol == c->buf + start) {
+				c->state = BENCH_CS_HEAD;
+				bench_complete(b, c);
+			}
+			break;
+
+		case BENCH_CS_PARKED:
+			return 0;
+		}
+		if (!head && bench_measured(b)) {
+			b->bytes_in += c->pos - start;
+		}
+		if (c->fd < 0 || c->state == BENCH_CS_PARKED) {
+			return 0;
+		}
+		if (c->pos == c->len) {
+			return 0;
+		}
+	}
+}
+
+static void bench_read (bench_t *b, bench_conn_t *c) {
+	char     *buf;
+	ssize_t   rc;
+
+	/* compact consumed input */
+	if (c->pos > 0) {
+		memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+		c->len -= c->pos;
+		c->pos = 0;
+	}
+	if (c->cap - c->len < 65536) {
+		buf = realloc(c->buf, c->cap + 65536);
+		if (!buf) {
+			bench_fatal("out of memory");
+		}
+		c->buf = buf;
+		c->cap += 65536;
+	}
+	rc = recv(c->fd, c->buf + c->len, c->cap - c->len - 1, 0);
+	if (rc <= 0) {
+		if (rc < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return;
+		}
+		if (b->parked == c) {
+			b->parked = NULL;
+		}
+		bench_close(c);
+		return;
+	}
+	c->len += (size_t)rc;
+	c->buf[c->len] = '\0';
+	if (bench_parse(b, c) < 0) {
+		c->close = 1;
+		bench_send(b, c, "400 Bad Request", NULL, "{}", 2);
+	}
+}
+
+static void bench_accept (bench_t *b) {
+	int  fd, i, one;
+
+	fd = accept4(b->lfd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+	for (i = 0; i < BENCH_CONN_MAX; i++) {
+		if (b->conns[i].fd < 0) {
+			break;
+		}
+	}
+	if (i == BENCH_CONN_MAX) {
+		close(fd);
+		return;
+	}
+	one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	b->conns[i].fd = fd;
+	b->conns[i].state = BENCH_CS_HEAD;
+}
+
+static void bench_terminate (bench_t *b) {
+	uint64_t  deadline;
+
+	if (b->exited) {
+		return;
+	}
+	kill(b->pid, SIGTERM);
+	deadline = bench_now() + (uint64_t)BENCH_TERM_TIMEOUT_MS * 1000000ULL;
+	while (bench_now() < deadline) {
+		if (waitpid(b->pid, &b->status, WNOHANG) == b->pid) {
+			b->exited = 1;
+			return;
+		}
+		usleep(10000);
+	}
+	fprintf(stderr, "bench_e2e: bootstrap did not exit on SIGTERM; killing\n");
+	kill(b->pid, SIGKILL);
+	waitpid(b->pid, &b->status, 0);
+	b->exited = 1;
+}
+
+
+/*
+ * report
+ */
+
+static void bench_report (bench_t *b) {
+	int       i, step;
+	long      n;
+	double    secs;
+	uint64_t  rss_min, rss_max;
+
+	n = b->completed;
+	if (n == 0) {
+		printf("no invocations completed\n");
+		return;
+	}
+	secs = (double)(b->t_end - b->t_start) / 1e9;
+	qsort(b->latency, (size_t)n, sizeof(uint64_t), bench_cmp_u64);
+	qsort(b->ttfb, (size_t)n, sizeof(uint64_t), bench_cmp_u64);
+
+#define BENCH_PCT(a, p)  ((double)(a)[(size_t)((double)(n - 1) * (p))] / 1e3)
+	printf("events:         %d from %s\n", b->event_count, b->events_path);
+	printf("invocations:    %ld (warmup %ld, errors %ld)\n", n, b->warmup, b->errors);
+	if (b->expect) {
+		printf("truncated:      %ld (expected suffix \"%s\")\n", b->truncated, b->expect);
+	}
+	printf("elapsed:        %.3f s\n", secs);
+	printf("throughput:     %.1f invocations/s\n", secs > 0 ? (double)n / secs : 0.0);
+	printf("latency [us]:   p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+			BENCH_PCT(b->latency, 0.50), BENCH_PCT(b->latency, 0.90),
+			BENCH_PCT(b->latency, 0.99), BENCH_PCT(b->latency, 0.999),
+			(double)b->latency[n - 1] / 1e3);
+	printf("ttfb [us]:      p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+			BENCH_PCT(b->ttfb, 0.50), BENCH_PCT(b->ttfb, 0.90), BENCH_PCT(b->ttfb, 0.99),
+			BENCH_PCT(b->ttfb, 0.999), (double)b->ttfb[n - 1] / 1e3);
+	printf("wire bytes:     in %llu (%.1f/inv)  out %llu (%.1f/inv)\n",
+			(unsigned long long)b->bytes_in, (double)b->bytes_in / (double)n,
+			(unsigned long long)b->bytes_out, (double)b->bytes_out / (double)n);
+#undef BENCH_PCT
+
+	if (b->rss_count == 0) {
+		return;
+	}
+	rss_min = rss_max = b->rss[0];
+	for (i = 1; i < b->rss_count; i++) {
+		if (b->rss[i] < rss_min) {
+			rss_min = b->rss[i];
+		}
+		if (b->rss[i] > rss_max) {
+			rss_max = b->rss[i];
+		}
+	}
+	printf("rss [KiB]:      min %llu  max %llu  last %llu\n", (unsigned long long)rss_min / 1024,
+			(unsigned long long)rss_max / 1024,
+			(unsigned long long)b->rss[b->rss_count - 1] / 1024);
+	step = b->rss_count > BENCH_RSS_REPORT_MAX ? b->rss_count / BENCH_RSS_REPORT_MAX : 1;
+	for (i = 0; i < b->rss_count; i += step) {
+		printf("  t=%8.3f s  rss=%llu KiB\n", (double)(b->rss_t[i] - b->rss_t[0]) / 1e9,
+				(unsigned long long)b->rss[i] / 1024);
+	}
+}
+
+
+/*
+ * main
+ */
+
+static void bench_usage (void) {
+	fprintf(stderr, "usage: bench_e2e [-n invocations] [-w warmup] [-e events] [-t task_root]\n"
+			"                 [-r rss_interval_ms] [-p port] [-x body_suffix] [-v]\n"
+			"                 bootstrap [args...]\n");
+	exit(EXIT_FAILURE);
+}
+
+int main (int argc, char *argv[]) {
+	int            i, opt, port, nfds, timeout;
+	char           api[64];
+	bench_t       *b;
+	uint64_t       now;
+	struct pollfd  pfds[BENCH_CONN_MAX + 1];
+	bench_conn_t  *map[BENCH_CONN_MAX + 1];
+
+	/* configuration */
+	b = calloc(1, sizeof(bench_t));
+	if (!b) {
+		bench_fatal("out of memory");
+	}
+	b->invocations = 10000;
+	b->warmup = 100;
+	b->rss_interval = 100;
+	b->events_path = "test/bench/events";
+	b->task_root = "test/bench";
+	port = 0;
+	while ((opt = getopt(argc, argv, "+n:w:e:t:r:p:x:v")) != -1) {
+		switch (opt) {
+		case 'n':
+			b->invocations = atol(optarg);
+			break;
+
+		case 'w':
+			b->warmup = atol(optarg);
+			break;
+
+		case 'e':
+			b->events_path = optarg;
+			break;
+
+		case 't':
+			b->task_root = optarg;
+			break;
+
+		case 'r':
+			b->rss_interval = atol(optarg);
+			break;
+
+		case 'p':
+			port = atoi(optarg);
+			break;
+
+		case 'x':
+			b->expect = optarg;
+			break;
+
+		case 'v':
+			b->verbose = 1;
+			break;
+
+		default:
+			bench_usage();
+		}
+	}
+	if (optind >= argc || b->invocations <= 0 || b->warmup < 0 || b->rss_interval <= 0) {
+		bench_usage();
+	}
+	b->argv = argv + optind;
+	b->page_size = sysconf(_SC_PAGESIZE);
+	b->latency = calloc((size_t)b->invocations, sizeof(uint64_t));
+	b->ttfb = calloc((size_t)b->invocations, sizeof(uint64_t));
+	if (!b->latency || !b->ttfb) {
+		bench_fatal("out of memory");
+	}
+	for (i = 0; i < BENCH_CONN_MAX; i++) {
+		b->conns[i].fd = -1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	/* corpus, socket, and bootstrap */
+	bench_load_events(b);
+	port = bench_listen(b, port);
+	snprintf(api, sizeof(api), "127.0.0.1:%d", port);
+	if (setenv("AWS_LAMBDA_RUNTIME_API", api, 1) != 0
+			|| setenv("LAMBDA_TASK_ROOT", b->task_root, 1) != 0) {
+		bench_fatal("failed to set environment");
+	}
+	if (!getenv("AWS_LAMBDA_FUNCTION_MEMORY_SIZE")) {
+		setenv("AWS_LAMBDA_FUNCTION_MEMORY_SIZE", "128", 1);
+	}
+	bench_spawn(b);
+
+	/* serve */
+	while (b->completed < b->invocations) {
+		nfds = 0;
+		pfds[nfds].fd = b->lfd;
+		pfds[nfds].events = POLLIN;
+		map[nfds++] = NULL;
+		for (i = 0; i < BENCH_CONN_MAX; i++) {
+			if (b->conns[i].fd >= 0) {
+				pfds[nfds].fd = b->conns[i].fd;
+				pfds[nfds].events = POLLIN;
+				map[nfds++] = &b->conns[i];
+			}
+		}
+		now = bench_now();
+		timeout = (int)b->rss_interval - (int)((now - b->t_rss) / 1000000ULL);
+		if (timeout < 0) {
+			timeout = 0;
+		}
+		if (poll(pfds, (nfds_t)nfds, timeout) < 0 && errno != EINTR) {
+			bench_fatal("poll failed: %s", strerror(errno));
+		}
+		for (i = 0; i < nfds; i++) {
+			if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+				continue;
+			}
+			if (map[i]) {
+				if (map[i]->fd >= 0) {
+					bench_read(b, map[i]);
+				}
+			} else {
+				bench_accept(b);
+			}
+		}
+		now = bench_now();
+		if ((now - b->t_rss) / 1000000ULL >= (uint64_t)b->rss_interval) {
+			bench_sample_rss(b, now);
+		}
+		if (waitpid(b->pid, &b->status, WNOHANG) == b->pid) {
+			b->exited = 1;
+			bench_fatal("bootstrap exited prematurely status:%d", b->status);
+		}
+	}
+
+	/* finish */
+	bench_sample_rss(b, bench_now());
+	bench_terminate(b);
+	bench_report(b);
+	return b->errors || b->truncated ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -17,7 +17,12 @@ static void test_base64_encode_decode_1_block(void);
 static void test_base64_encode_decode_2_blocks(void);
 static void test_base64_decode_errors(void);
 static void test_base64_encode_len(void);
+static void test_base64_encode_to(void);
+static void test_base64_kernels(void);
+static void test_json_escape(void);
 static void test_utf8(void);
+static void test_utf8_kernels(void);
+static void test_json_escape_kernels(void);
 int main(void);
 
 
@@ -87,6 +92,12 @@ static void test_base64_encode_decode_2_blocks (void) {
 	assert(lws_base64_decode(buf, &len) == 0);
 	assert(len == 5);
 	assert(memcmp(buf, "hello", 5) == 0);
+
+	/* decode to a separate buffer */
+	memset(buf, 0, sizeof(buf));
+	assert(lws_base64_decode_to((const uint8_t *)"Zm9vYmFyYg==", 12, buf, &len) == 0);
+	assert(len == 7);
+	assert(memcmp(buf, "foobarb", 7) == 0);
 }
 
 static void test_base64_decode_errors (void) {
@@ -116,6 +127,128 @@ static void test_base64_encode_len (void) {
 	assert(lws_base64_encode_len(6, &out) == 0 && out == 8);
 }
 
+static void test_base64_encode_to (void) {
+	size_t   len, i;
+	uint8_t  in[64], out[128], ref[128];
+
+	/* matches in-place encoding for all lengths */
+	for (i = 0; i < sizeof(in); i++) {
+		in[i] = (uint8_t)(i * 37 + 11);
+	}
+	for (len = 0; len <= sizeof(in); len++) {
+		memcpy(ref, in, len);
+		i = len;
+		lws_base64_encode(ref, &i);
+		lws_base64_encode_to(in, len, out);
+		assert(memcmp(out, ref, i) == 0);
+	}
+
+	/* chunked at block boundaries */
+	lws_base64_encode_to((const uint8_t *)"foo", 3, out);
+	lws_base64_encode_to((const uint8_t *)"ba", 2, out + 4);
+	assert(memcmp(out, "Zm9vYmE=", 8) == 0);
+}
+
+static void test_base64_kernels (void) {
+	int                   isa;
+	size_t                len, enc_len, dec_len, i, pos;
+	uint8_t               in[300], ref[400], buf[400], out[400];
+	static const uint8_t  bad[] = { '!', '=', '-', '_', ' ', '\n', 0x00, 0x7f, 0x80, 0xff };
+
+	for (i = 0; i < sizeof(in); i++) {
+		in[i] = (uint8_t)(i * 151 + (i >> 3) * 7 + 3);
+	}
+
+	/* all supported kernels match the scalar path for all lengths */
+	for (isa = LWS_CODEC_SCALAR; isa <= LWS_CODEC_AVX512; isa++) {
+		if (lws_codec_set_isa((lws_codec_isa_e)isa) != 0) {
+			continue;
+		}
+		for (len = 0; len <= sizeof(in); len++) {
+			/* scalar reference */
+			assert(lws_codec_set_isa(LWS_CODEC_SCALAR) == 0);
+			memcpy(ref, in, len);
+			enc_len = len;
+			lws_base64_encode(ref, &enc_len);
+			assert(lws_codec_set_isa((lws_codec_isa_e)isa) == 0);
+
+			/* encode in place and to a separate buffer */
+			memcpy(buf, in, len);
+			i = len;
+			lws_base64_encode(buf, &i);
+			assert(i == enc_len && memcmp(buf, ref, enc_len) == 0);
+			lws_base64_encode_to(in, len, out);
+			assert(memcmp(out, ref, enc_len) == 0);
+
+			/* decode in place and to a separate buffer */
+			assert(lws_base64_decode_to(ref, enc_len, out, &dec_len) == 0);
+			assert(dec_len == len && memcmp(out, in, len) == 0);
+			assert(lws_base64_decode(buf, &i) == 0);
+			assert(i == len && memcmp(buf, in, len) == 0);
+		}
+
+		/* invalid characters are rejected at every position (save trailing padding) */
+		len = sizeof(in) / 3 * 3;
+		memcpy(ref, in, len);
+		enc_len = len;
+		lws_base64_encode(ref, &enc_len);
+		for (pos = 0; pos < enc_len; pos++) {
+			for (i = 0; i < sizeof(bad); i++) {
+				if (bad[i] == '=' && pos == enc_len - 1) {
+					continue;
+				}
+				memcpy(buf, ref, enc_len);
+				buf[pos] = bad[i];
+				assert(lws_base64_decode_to(buf, enc_len, out, &dec_len) == -1);
+			}
+		}
+	}
+	lws_codec_init();
+}
+
+static void test_json_escape (void) {
+	size_t        len, in_len, o;
+	uint8_t       out[64];
+	const char   *s;
+
+	/* escape length */
+	s = "a\"b\\c\n\x01\xc3\xa9";
+	assert(lws_json_escape_len((const uint8_t *)s, strlen(s), &len) == 0);
+	assert(len == 1 + 2 + 1 + 2 + 1 + 2 + 6 + 2);
+
+	/* escape */
+	in_len = strlen(s);
+	o = lws_json_escape((const uint8_t *)s, &in_len, out, sizeof(out));
+	assert(in_len == strlen(s));
+	assert(o == len);
+	assert(memcmp(out, "a\\\"b\\\\c\\n\\u0001\xc3\xa9", o) == 0);
+
+	/* partial output never splits an escape sequence */
+	s = "ab\x1f";
+	in_len = 3;
+	o = lws_json_escape((const uint8_t *)s, &in_len, out, 5);
+	assert(in_len == 2 && o == 2);
+	in_len = 1;
+	o = lws_json_escape((const uint8_t *)s + 2, &in_len, out, 6);
+	assert(in_len == 1 && o == 6);
+	assert(memcmp(out, "\\u001f", 6) == 0);
+
+	/* unescape, including a surrogate pair and in place */
+	s = "a\\\"b\\\\c\\n\\u0001\\u00e9\\ud83d\\ude00\\/";
+	assert(lws_json_unescape((const uint8_t *)s, strlen(s), out, &o) == 0);
+	assert(o == 14 && memcmp(out, "a\"b\\c\n\x01\xc3\xa9\xf0\x9f\x98\x80/", o) == 0);
+	memcpy(out, "x\\ty", 4);
+	assert(lws_json_unescape(out, 4, out, &o) == 0);
+	assert(o == 3 && memcmp(out, "x\ty", 3) == 0);
+
+	/* malformed escapes */
+	assert(lws_json_unescape((const uint8_t *)"a\\", 2, out, &o) == -1);
+	assert(lws_json_unescape((const uint8_t *)"\\x", 2, out, &o) == -1);
+	assert(lws_json_unescape((const uint8_t *)"\\u12g4", 6, out, &o) == -1);
+	assert(lws_json_unescape((const uint8_t *)"\\ude00", 6, out, &o) == -1);
+	assert(lws_json_unescape((const uint8_t *)"\\ud83dx", 7, out, &o) == -1);
+}
+
 static void test_utf8 (void) {
 	/* valid ascii */
 	assert(lws_valid_utf8((const uint8_t *)"hello", 5) == 0);
@@ -143,13 +276,119 @@ static void test_utf8 (void) {
 		uint8_t bad2[] = {0xC2};
 		assert(lws_valid_utf8(bad2, sizeof(bad2)) == -1);
 	}
+
+	/* incremental: sequence split across updates, then rejected */
+	{
+		uint32_t state;
+		uint8_t  smile[] = {0xF0,0x9F,0x98,0x80};
+		state = lws_utf8_update(LWS_UTF8_ACCEPT, smile, 2);
+		assert(state != LWS_UTF8_ACCEPT && state != LWS_UTF8_REJECT);
+		state = lws_utf8_update(state, smile + 2, 2);
+		assert(state == LWS_UTF8_ACCEPT);
+		state = lws_utf8_update(state, smile + 1, 3);
+		assert(state == LWS_UTF8_REJECT);
+	}
+}
+
+static void test_utf8_kernels (void) {
+	int                   isa;
+	size_t                n, len, pos, split;
+	uint8_t               buf[256];
+	uint32_t              ref, state, seed;
+	static const uint8_t  seqs[][4] = {
+		{ 'a' }, { 0x7f }, { 0xc2, 0x80 }, { 0xdf, 0xbf }, { 0xe0, 0xa0, 0x80 },
+		{ 0xed, 0x9f, 0xbf }, { 0xee, 0x80, 0x80 }, { 0xef, 0xbf, 0xbf },
+		{ 0xf0, 0x90, 0x80, 0x80 }, { 0xf4, 0x8f, 0xbf, 0xbf }
+	};
+	static const uint8_t  seq_len[] = { 1, 1, 2, 2, 3, 3, 3, 3, 4, 4 };
+
+	/* all supported kernels match the DFA on valid, corrupted and truncated input */
+	seed = 1;
+	for (n = 0; n < 20000; n++) {
+		len = 0;
+		while (len + 4 <= sizeof(buf)) {
+			seed = seed * 1103515245 + 12345;
+			pos = (seed >> 16) % (sizeof(seq_len) * 2);
+			pos = pos < sizeof(seq_len) ? pos : 0;
+			memcpy(buf + len, seqs[pos], seq_len[pos]);
+			len += seq_len[pos];
+		}
+		seed = seed * 1103515245 + 12345;
+		if (n % 3) {
+			buf[(seed >> 8) % len] = (uint8_t)(seed >> 24);
+		}
+		if (n % 5 == 0) {
+			len -= (seed >> 4) % 4;
+		}
+		split = (seed >> 12) % (len + 1);
+		assert(lws_codec_set_isa(LWS_CODEC_SCALAR) == 0);
+		ref = lws_utf8_update(LWS_UTF8_ACCEPT, buf, len);
+		for (isa = LWS_CODEC_SCALAR; isa <= LWS_CODEC_AVX512; isa++) {
+			if (lws_codec_set_isa((lws_codec_isa_e)isa) != 0) {
+				continue;
+			}
+			assert(lws_utf8_update(LWS_UTF8_ACCEPT, buf, len) == ref);
+			state = lws_utf8_update(LWS_UTF8_ACCEPT, buf, split);
+			assert(lws_utf8_update(state, buf + split, len - split) == ref);
+		}
+	}
+	lws_codec_init();
+}
+
+static void test_json_escape_kernels (void) {
+	int                 isa;
+	size_t              n, len, ref_len, esc_len, in_len, out_len, o, ref_o, ref_in, split;
+	uint8_t             buf[320], out[2048], ref[2048];
+	uint32_t            state, seed;
+	static const char  *parts[] = { "abc", "\"", "\\", "\n", "\x01", "\x1f", "\x7f", "\xc3\xa9",
+			"\xe2\x82\xac", "\xf0\x9f\x98\x80", "0123456789abcdef" };
+
+	/* the fused UTF-8 and escaped length pass and escaping match the scalar path */
+	seed = 3;
+	for (n = 0; n < 5000; n++) {
+		len = 0;
+		for (;;) {
+			seed = seed * 1103515245 + 12345;
+			in_len = strlen(parts[(seed >> 16) % 11]);
+			if (len + in_len > sizeof(buf) - (n % 7)) {
+				break;
+			}
+			memcpy(buf + len, parts[(seed >> 16) % 11], in_len);
+			len += in_len;
+		}
+		split = (seed >> 8) % (len + 1);
+		assert(lws_codec_set_isa(LWS_CODEC_SCALAR) == 0);
+		assert(lws_json_escape_len(buf, len, &ref_len) == 0);
+		out_len = (seed >> 4) % (ref_len + 1);
+		ref_in = len;
+		ref_o = lws_json_escape(buf, &ref_in, ref, out_len);
+		for (isa = LWS_CODEC_SCALAR; isa <= LWS_CODEC_AVX512; isa++) {
+			if (lws_codec_set_isa((lws_codec_isa_e)isa) != 0) {
+				continue;
+			}
+			esc_len = 0;
+			state = lws_utf8_escape_update(LWS_UTF8_ACCEPT, buf, split, &esc_len);
+			state = lws_utf8_escape_update(state, buf + split, len - split, &esc_len);
+			assert(state == LWS_UTF8_ACCEPT && esc_len == ref_len);
+			in_len = len;
+			o = lws_json_escape(buf, &in_len, out, out_len);
+			assert(o == ref_o && in_len == ref_in && memcmp(out, ref, o) == 0);
+		}
+	}
+	lws_codec_init();
 }
 
 int main (void) {
+	lws_codec_init();
 	test_base64_encode_decode_1_block();
 	test_base64_encode_decode_2_blocks();
 	test_base64_encode_len();
 	test_base64_decode_errors();
+	test_base64_encode_to();
+	test_base64_kernels();
+	test_json_escape();
 	test_utf8();
+	test_utf8_kernels();
+	test_json_escape_kernels();
 	return EXIT_SUCCESS;
 }